@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <type_traits>
+
+namespace fs::core {
+
+/**
+ * @brief Free-space bitmap view working on 64-bit words. Bits are numbered from the most
+ *        significant bit of the first byte, so on-disk layout does not depend on word size.
+ */
+template <class Byte>
+class BasicBitmap
+{
+public:
+    /**
+     * @brief View @a bytes as bitmap.
+     */
+    explicit BasicBitmap(std::span<Byte> bytes) noexcept;
+
+    [[nodiscard]]
+    auto size() const noexcept -> std::size_t;
+
+    [[nodiscard]]
+    auto test(std::size_t index) const noexcept -> bool;
+
+    void set(std::size_t index, bool value) noexcept
+        requires (!std::is_const_v<Byte>);
+
+    /**
+     * @brief Count zero bits in [@a first, @a last).
+     */
+    [[nodiscard]]
+    auto count_zeros(std::size_t first, std::size_t last) const noexcept -> std::size_t;
+
+    /**
+     * @brief Find first zero bit in [@a first, @a last).
+     */
+    [[nodiscard]]
+    auto find_zero(std::size_t first, std::size_t last) const noexcept -> std::optional<std::size_t>;
+
+    /**
+     * @brief Find first set bit in [@a first, @a last).
+     */
+    [[nodiscard]]
+    auto find_one(std::size_t first, std::size_t last) const noexcept -> std::optional<std::size_t>;
+
+    /**
+     * @brief Find start of the first run of @a count zero bits in [@a first, @a last).
+     */
+    [[nodiscard]]
+    auto find_zero_run(std::size_t count, std::size_t first, std::size_t last) const noexcept -> std::optional<std::size_t>;
+
+private:
+    static constexpr std::size_t kWordBits = 64u;
+
+    /**
+     * @brief Load @a word-th 64-bit word, bits outside of [@a first, @a last) are set to @a outside.
+     */
+    [[nodiscard]]
+    auto load(std::size_t word, std::size_t first, std::size_t last, bool outside) const noexcept -> std::uint64_t;
+
+    std::span<Byte> _bytes;
+};
+
+using Bitmap = BasicBitmap<std::byte>;
+using ConstBitmap = BasicBitmap<const std::byte>;
+
+extern template class BasicBitmap<std::byte>;
+extern template class BasicBitmap<const std::byte>;
+
+} // namespace fs::core
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Core/Layout.hpp>
+#include <IO.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace fs::core {
+
+/**
+ * @brief Cursor over packed values of @a Type laid out back to back in a chain of disk blocks.
+ *        Values are decoded straight out of block views, the ones straddling block boundary
+ *        are assembled on the stack. Cursor over mutable IO can also write values back in place.
+ */
+template <PackedLayout Type, class IOType = const IO>
+class BlockCursor
+{
+public:
+    static constexpr std::size_t value_size = Packed<Type>::size;
+
+    /**
+     * @brief Place cursor at byte @a offset of the chain of @a blocks.
+     */
+    BlockCursor(IOType& io, std::span<const std::size_t> blocks, std::size_t offset = 0u) noexcept
+        : BlockCursor{io, blocks, offset, io.block_length()}
+    {}
+
+    /**
+     * @brief Place cursor at byte @a offset of the chain of @a blocks, which are @a block_length bytes long.
+     *        Constant @a block_length lets caller's block arithmetic be folded at compile time.
+     */
+    BlockCursor(IOType& io, std::span<const std::size_t> blocks, std::size_t offset, std::size_t block_length) noexcept
+        : _io{&io}
+        , _blocks{blocks}
+        , _block_length{block_length}
+        , _offset{offset}
+    {}
+
+    /**
+     * @brief Check whether the rest of the chain is too short for a value.
+     */
+    [[nodiscard]]
+    auto done() const noexcept -> bool {
+        return _offset + value_size > _blocks.size() * _block_length;
+    }
+
+    /**
+     * @brief Byte offset of the current value from the beginning of the chain.
+     */
+    [[nodiscard]]
+    auto offset() const noexcept -> std::size_t {
+        return _offset;
+    }
+
+    void next() noexcept {
+        _offset += value_size;
+    }
+
+    [[nodiscard]]
+    auto get() const noexcept -> Type {
+        std::array<std::byte, value_size> bytes;
+        for_each_piece([this, &bytes](std::size_t block, std::size_t byte, std::size_t length, std::size_t done) {
+            const auto view = std::as_const(*_io).block(block);
+            std::copy_n(view.begin() + byte, length, bytes.begin() + done);
+        });
+        return Packed<Type>::decode(bytes);
+    }
+
+    void put(const Type& value) noexcept
+        requires (!std::is_const_v<IOType>)
+    {
+        std::array<std::byte, value_size> bytes;
+        Packed<Type>::encode(value, bytes);
+        for_each_piece([this, &bytes](std::size_t block, std::size_t byte, std::size_t length, std::size_t done) {
+            const auto view = _io->block(block); // block is patched in place
+            std::copy_n(bytes.begin() + done, length, view.begin() + byte);
+        });
+    }
+
+private:
+    /**
+     * @brief Call @a visitor(block, byte, length, done) for every piece of the current value within one block.
+     */
+    template <class Visitor>
+    void for_each_piece(Visitor visitor) const {
+        auto block = _offset / _block_length;
+        auto byte = _offset % _block_length;
+        for (std::size_t done = 0u; done < value_size; ++block, byte = 0u) {
+            const auto length = std::min(value_size - done, _block_length - byte);
+            visitor(_blocks[block], byte, length, done);
+            done += length;
+        }
+    }
+
+    IOType* _io;                          // I/O system holding the blocks
+    std::span<const std::size_t> _blocks; // chain of disk blocks
+    std::size_t _block_length;
+    std::size_t _offset;                  // position of the current value in the chain
+};
+
+} // namespace fs::core
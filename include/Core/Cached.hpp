@@ -1,30 +1,82 @@
 #pragma once
 
 #include <Core/Default.hpp>
+#include <Core/PageCache.hpp>
+#include <functional>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace fs::core {
 
+/**
+ * @brief Memory budget of page cache and directory caches, unless another one is given.
+ */
+inline constexpr std::size_t default_cache_length = 1u << 20;
+
+/**
+ * @brief Part of memory budget given to directory listings and dentries, the rest holds pages.
+ */
+inline constexpr std::size_t directory_cache_share = 4u;    // one quarter
+
+/**
+ * @brief When written file data reaches I/O system.
+ */
+enum class WritePolicy {
+    write_through,    // every write goes to disk at once
+    write_back,       // writes are coalesced in memory and go to disk on close, save, flush or when too many are pending
+};
+
 /**
  * @brief Implementation of communication with I/O subsystem that
- *        caches some data.
+ *        caches some data. File data goes through bounded page cache shared by all files.
+ *        Directory listings and dentries share a bounded budget too, least recently used directories go first.
+ *        Page cache and directory caches have their own locks, so concurrency rules of BasicDefault hold.
  */
-class Cached final : public Default
+template <std::size_t BlockLength>
+class BasicCached final : public BasicDefault<BlockLength>
 {
 public:
     /**
      * @brief Initialize with pointer to I/O system.
      */
-    explicit Cached(std::unique_ptr<IO> io);
+    explicit BasicCached(std::unique_ptr<IO> io);
+
+    /**
+     * @brief Initialize with pointer to I/O system and caches of at most @a cache_length bytes,
+     *        pages of which are replaced according to @a policy.
+     */
+    BasicCached(std::unique_ptr<IO> io, std::size_t cache_length, PageCache::Policy policy,
+                WritePolicy write_policy = WritePolicy::write_through);
 
     /**
-     * @brief Close file and possibly free all associated resources.
+     * @brief Write pending data back to disk.
+     */
+    ~BasicCached() override;
+
+    /**
+     * @brief Close file, writing its pending data back to disk.
      */
     void close(Directory::Entry::index_type index) override;
 
     /**
-     * @brief Read data into @a dst start from provided @a pos.
+     * @brief Write pending data of all files back to disk.
+     */
+    void flush() override;
+
+    /**
+     * @brief Write pending data back and save content into specified file in chosen image format.
+     */
+    void save(std::string_view path, IO::Format format) override;
+
+    /**
+     * @brief Read data into @a dst start from provided @a pos. Sequential reads fetch a growing window of pages ahead.
      */
     [[nodiscard]]
     auto read(Directory::Entry::index_type index,
@@ -44,6 +96,9 @@ public:
      */
     auto create(Directory::index_type dir, const File& file) -> Directory::Entry::index_type override;
 
+    /**
+     * @brief Search file by name in directory, memoizing found entries in dentry cache.
+     */
     [[nodiscard]]
     auto search(Directory::index_type dir, std::string_view name) const
      -> std::optional<Directory::Entry::index_type> override;
@@ -54,21 +109,182 @@ public:
     void remove(Directory::index_type dir, Directory::Entry::index_type index) override;
 
     /**
-     * @brief List all entries in directory sorted by name.
+     * @brief List all entries in directory sorted by name. Cached listing is shared with the caller,
+     *        later changes of directory copy it first.
      */
     [[nodiscard]]
-    auto get(Directory::index_type dir) const -> std::optional<Directory> override;
+    auto get(Directory::index_type dir) const -> std::shared_ptr<const Directory> override;
 
+    /**
+     * @brief Stream entries of directory, in name order if its listing is cached. Uncached directory
+     *        is streamed from disk and is not cached, as only a few of its entries may be needed.
+     */
+    void for_each_entry(Directory::index_type dir, std::string_view prefix, const Interface::EntryVisitor& visitor) const override;
+
+    /**
+     * @brief Hit, miss and eviction counters of page cache.
+     */
+    [[nodiscard]]
+    auto cache_stats() const -> std::optional<PageCache::Stats> override;
+
+    /**
+     * @brief Reset counters of I/O system and page cache.
+     */
+    void reset_stats() override;
 
 private:
-    mutable std::unordered_map<Directory::index_type, Directory> _dir_cache;
-    mutable std::unordered_map<Directory::Entry::index_type, std::pair<Directory::index_type, std::string>> _entry_info_cache;  // used for updating file`s sizes
+    using Base = BasicDefault<BlockLength>;
+
+    /**
+     * @brief Hash of name, accepting both owning and viewing names.
+     */
+    struct NameHash {
+        using is_transparent = void;
 
-    struct Buffer {
-        std::size_t buf_start_pos;
-        std::vector<std::byte> data;
+        auto operator()(std::string_view name) const noexcept -> std::size_t {
+            return std::hash<std::string_view>{}(name);
+        }
     };
-    mutable std::unordered_map<Directory::Entry::index_type, Buffer> _buffers;
+
+    /**
+     * @brief What is known about one directory: its complete listing, or names resolved in it so far.
+     */
+    struct CachedDirectory {
+        std::shared_ptr<Directory> listing;    // handed out as snapshots, null until directory is listed
+        std::unordered_map<std::string, Directory::Entry::index_type, NameHash, std::equal_to<>> dentries;    // only while not listed
+        std::size_t charge = 0u;    // bytes counted against directory budget
+        std::list<Directory::index_type>::iterator recent;    // position in _recent_directories
+    };
+
+    /**
+     * @brief Pages of a file written in write-back mode, but not on disk yet.
+     */
+    struct DirtyFile {
+        std::map<std::size_t, PageCache::Page> pages;    // dirty pages by index, in file order
+        std::size_t length;                              // file length including pending writes
+    };
+
+    /**
+     * @brief Sequential access pattern in an open file. A file read through several handles
+     *        at once has one stream per handle, told apart by where each one stopped.
+     */
+    struct Stream {
+        std::size_t next_pos;    // position right after the previous read
+        std::size_t window;      // pages read ahead on the next miss, zero for random access
+    };
+
+    /**
+     * @brief Take out stream of file continued by read at @a pos, or start a new one.
+     * @return stream and whether read continues it
+     */
+    auto take_stream(Directory::Entry::index_type index, std::size_t pos) const -> std::pair<Stream, bool>;
+
+    /**
+     * @brief Put stream back as the most recent one of file, forgetting the least recent one if there are too many.
+     */
+    void put_stream(Directory::Entry::index_type index, const Stream& stream) const;
+
+    /**
+     * @brief Get length of file including data not written back yet.
+     *        This and other helpers touching pages expect caller to hold _cache_mutex.
+     */
+    [[nodiscard]]
+    auto logical_length(Directory::Entry::index_type index) const -> std::size_t;
+
+    /**
+     * @brief Find page holding the latest data at @a page of file, pending one first.
+     */
+    [[nodiscard]]
+    auto cached_page(Directory::Entry::index_type index, std::size_t page) const -> const PageCache::Page*;
+
+    /**
+     * @brief Zero-extend cached page holding the end of file, when file grows from @a old_length to @a new_length.
+     *        Cached page always holds the file up to its end or up to the end of page.
+     */
+    void extend_last_page(Directory::Entry::index_type index, std::size_t old_length, std::size_t new_length);
+
+    /**
+     * @brief Copy @a bytes just written at @a pos of file into its cached pages, so they stay valid.
+     */
+    void update_pages(Directory::Entry::index_type index, std::size_t pos, std::span<const std::byte> bytes);
+
+    /**
+     * @brief Put @a src written at @a pos into pending pages of file, fetching partially overwritten ones.
+     * @return number of bytes accepted
+     */
+    auto write_pending(Directory::Entry::index_type index, std::size_t pos, std::span<const std::byte> src) -> std::size_t;
+
+    /**
+     * @brief Write pending pages of file to disk, runs of adjacent pages in one request, and keep them as clean.
+     */
+    void write_back(Directory::Entry::index_type index);
+
+    /**
+     * @brief Read directory listing from disk, sizes of files with pending writes included.
+     */
+    [[nodiscard]]
+    auto fetch_directory(Directory::index_type dir) const -> std::shared_ptr<Directory>;
+
+    /**
+     * @brief Find cached directory and mark it as the most recently used one.
+     *        This and other helpers of directory caches expect caller to hold _dentry_mutex.
+     */
+    auto touch_directory(Directory::index_type dir) const -> CachedDirectory*;
+
+    /**
+     * @brief Cache listing of directory instead of its dentries, unless it alone exceeds directory budget.
+     */
+    void cache_listing(Directory::index_type dir, const std::shared_ptr<Directory>& listing) const;
+
+    /**
+     * @brief Remember that @a name in directory resolves to @a index.
+     */
+    void cache_dentry(Directory::index_type dir, std::string_view name, Directory::Entry::index_type index) const;
+
+    /**
+     * @brief Count @a bytes more (or fewer) against directory budget and evict least recently used directories
+     *        other than @a dir until budget is met.
+     */
+    void charge_directory(Directory::index_type dir, std::ptrdiff_t bytes) const;
+
+    /**
+     * @brief Forget everything cached about directory.
+     */
+    void drop_directory(Directory::index_type dir) const;
+
+    mutable std::mutex _dentry_mutex;    // guards directory caches below
+    mutable std::unordered_map<Directory::index_type, CachedDirectory> _directories;    // listings and path components resolved so far
+    mutable std::list<Directory::index_type> _recent_directories;    // cached directories, most recently used first
+    mutable std::size_t _directory_bytes = 0u;    // charge of all cached directories
+    std::size_t _directory_capacity;              // directory budget in bytes
+    mutable std::unordered_map<Directory::Entry::index_type, std::pair<Directory::index_type, std::string>> _entry_info_cache;  // used for updating file`s sizes
+    mutable std::mutex _cache_mutex;    // guards pages, streams and pending writes, never held while taking _dentry_mutex
+    mutable PageCache _pages;    // blocks of file data, one page per block
+    mutable std::unordered_map<Directory::Entry::index_type, std::vector<Stream>> _streams;    // read patterns of open files, most recent first, for read-ahead
+    WritePolicy _write_policy;
+    std::unordered_map<Directory::Entry::index_type, DirtyFile> _dirty;    // files with pending writes
+    std::size_t _dirty_pages = 0u;                                          // pending pages of all files
 };
 
+using Cached = BasicCached<dynamic_block_length>;
+
+extern template class BasicCached<dynamic_block_length>;
+extern template class BasicCached<64u>;
+extern template class BasicCached<128u>;
+extern template class BasicCached<256u>;
+extern template class BasicCached<512u>;
+extern template class BasicCached<1024u>;
+extern template class BasicCached<2048u>;
+extern template class BasicCached<4096u>;
+
+/**
+ * @brief Create caching core for @a io, specialized for its block length if it is one of
+ *        specialized_block_lengths, or computing block arithmetic at runtime otherwise.
+ */
+[[nodiscard]]
+auto make_cached(std::unique_ptr<IO> io,
+                 std::size_t cache_length = default_cache_length,
+                 PageCache::Policy policy = PageCache::Policy::arc,
+                 WritePolicy write_policy = WritePolicy::write_through) -> Interface::Ptr;
+
 } // namespace fs::core
@@ -1,27 +1,54 @@
 #pragma once
 
+#include <Core/BlockCursor.hpp>
 #include <Core/Interface.hpp>
+#include <Core/Layout.hpp>
 #include <IO.hpp>
 #include <Error.hpp>
 
+#include <algorithm>
+#include <bit>
 #include <memory>
-#include <deque>
+#include <mutex>
 #include <iterator>
 #include <span>
-#include <cstring>
+#include <utility>
+#include <vector>
 
 namespace fs::core {
 
 /**
- * @brief Default implementation of interface between FS and I/O.
+ * @brief Block length taken from I/O system at runtime rather than fixed at compile time.
  */
-class Default : public Interface
+inline constexpr std::size_t dynamic_block_length = 0u;
+
+/**
+ * @brief Block lengths core is specialized for at compile time, so block arithmetic is folded into shifts.
+ */
+using specialized_block_lengths = std::index_sequence<64u, 128u, 256u, 512u, 1024u, 2048u, 4096u>;
+
+/**
+ * @brief Default implementation of interface between FS and I/O for disks with @a BlockLength blocks.
+ *        Operations on different files may run in parallel with each other and with lookups and listings:
+ *        block allocation and the descriptor table are guarded by a mutex, scratch buffers are per thread.
+ *        Caller serializes operations on the same file and keeps create, remove, flush and save exclusive.
+ */
+template <std::size_t BlockLength>
+class BasicDefault : public Interface
 {
+    static_assert(BlockLength == dynamic_block_length || std::has_single_bit(BlockLength),
+                  "only power-of-two block lengths are specialized");
+
 public:
     /**
      * @brief Initialize with pointer to I/O system.
      */
-    explicit Default(std::unique_ptr<IO> io);
+    explicit BasicDefault(std::unique_ptr<IO> io);
+
+    /**
+     * @brief Write modified descriptors back to disk.
+     */
+    ~BasicDefault() override;
 
     /**
      * @brief Close file and possibly free all associated resources.
@@ -56,25 +83,67 @@ public:
     auto search(Directory::index_type dir, std::string_view name) const
         -> std::optional<Directory::Entry::index_type> override;
 
+    [[nodiscard]]
+    auto is_directory(Directory::Entry::index_type index) const -> bool override;
+
     /**
      * @brief Remove file from the directory.
      */
     void remove(Directory::index_type dir, Directory::Entry::index_type index) override;
 
     /**
-     * @brief List all entries in directory.
+     * @brief List all entries in directory, reading it anew on every call.
      */
     [[nodiscard]]
-    auto get(Directory::index_type dir) const -> std::optional<Directory> override;
+    auto get(Directory::index_type dir) const -> std::shared_ptr<const Directory> override;
+
+    /**
+     * @brief Stream entries of directory in slot order, building an entry only for names matching @a prefix.
+     */
+    void for_each_entry(Directory::index_type dir, std::string_view prefix, const EntryVisitor& visitor) const override;
 
     /**
-     * @brief Save content for further restoring into specified file.
+     * @brief Save content for further restoring into specified file in chosen image format.
      */
-    void save(std::string_view path) const final;
+    void save(std::string_view path, IO::Format format) override;
+
+    /**
+     * @brief Write modified descriptors to disk.
+     */
+    void flush() override;
+
+    [[nodiscard]]
+    auto io_stats() const -> io::LatencyModel::Stats override;
+
+    /**
+     * @brief Nothing, file data is not cached.
+     */
+    [[nodiscard]]
+    auto cache_stats() const -> std::optional<PageCache::Stats> override;
+
+    void reset_stats() override;
 
 protected:
     [[nodiscard]]
-    auto block_length() const noexcept -> std::size_t;
+    constexpr auto block_length() const noexcept -> std::size_t {
+        if constexpr (BlockLength == dynamic_block_length) {
+            return _io->block_length();
+        } else {
+            return BlockLength;
+        }
+    }
+
+    /**
+     * @brief Read all entries of directory from disk, sorted by name
+     */
+    [[nodiscard]]
+    auto list_directory(Directory::index_type dir) const -> Directory;
+
+    /**
+     * @brief Get length of file as stored on disk
+     */
+    [[nodiscard]]
+    auto file_length(Directory::Entry::index_type index) const noexcept -> std::size_t;
 
     /**
      * @brief Initialize root directory
@@ -90,7 +159,7 @@ protected:
 
 
     /**
-     * @brief Finds position of a structure satisfying the @a predicate in a sequence of blocks (TODO: concepts?)
+     * @brief Finds position of a structure satisfying the @a predicate in a sequence of blocks
      *
      * @param begin,end range of disc block indexes to examine
      * @param predicate unary predicate
@@ -158,6 +227,138 @@ protected:
             std::size_t blocks_allocated,
             std::size_t blocks_to_allocate,
             std::size_t block_length) -> std::size_t;
+    /**
+     * @brief Read directory entry from hash table slot
+     */
+    [[nodiscard]]
+    auto read_entry(const Descriptor& directory, std::size_t slot) const -> DirectoryEntry;
+
+    /**
+     * @brief Write directory entry to hash table slot
+     */
+    void write_entry(const Descriptor& directory, std::size_t slot, const DirectoryEntry& entry);
+
+    /**
+     * @brief Find slot of the entry with @a name probing only slots near its home slot
+     * @return slot or nullopt if there is no such entry
+     */
+    [[nodiscard]]
+    auto find_entry(const Descriptor& directory, std::string_view name) const -> std::optional<std::size_t>;
+
+    /**
+     * @brief Put @a entry into directory hash table, growing it if there is no free slot near the home one
+     * @return slot of the entry
+     */
+    auto insert_entry(std::size_t dir, Descriptor& directory, const DirectoryEntry& entry) -> std::size_t;
+
+    /**
+     * @brief Grow hash table of directory @a dir and redistribute its entries dropping tombstones
+     */
+    void rehash_directory(std::size_t dir, Descriptor& directory);
+
+    /**
+     * @brief Get descriptor of directory @a dir, throw if there is no such directory
+     */
+    [[nodiscard]]
+    auto directory_descriptor(Directory::index_type dir) const -> const Descriptor&;
+
+    /**
+     * @brief Check whether directory has any entry
+     */
+    [[nodiscard]]
+    auto has_entries(const Descriptor& directory) const -> bool;
+
+    /**
+     * @brief Read superblock at the beginning of the first bitmap block
+     */
+    [[nodiscard]]
+    auto read_superblock() const -> Superblock;
+
+    /**
+     * @brief Load descriptor table from descriptor blocks and collect free descriptors
+     */
+    void load_descriptors();
+
+    /**
+     * @brief Write modified descriptors back to descriptor blocks
+     */
+    void flush_descriptors();
+
+    /**
+     * @brief Replace descriptor in resident table, it gets to disk on flush
+     */
+    void update_descriptor(std::size_t index, const Descriptor& descriptor);
+
+    /**
+     * @brief Free data block
+     */
+    void free_block(std::size_t block);
+
+    /**
+     * @brief Allocate zero-filled block of pointers
+     * @return allocated block or 0 if disk is full
+     */
+    auto allocate_index_block() -> std::size_t;
+
+    [[nodiscard]]
+    auto read_pointer(std::size_t block, std::size_t index) const -> std::size_t;
+
+    void write_pointer(std::size_t block, std::size_t index, std::size_t pointer);
+
+    /**
+     * @brief Get disk block holding data block @a n of a file
+     */
+    [[nodiscard]]
+    auto file_block(const Descriptor& descriptor, std::size_t n) const -> std::size_t;
+
+    /**
+     * @brief Set disk block holding data block @a n of a file, allocating indirect blocks if needed
+     * @return false if indirect block could not be allocated
+     */
+    auto set_file_block(Descriptor& descriptor, std::size_t n, std::size_t block) -> bool;
+
+    /**
+     * @brief Get disk blocks holding data blocks [@a first, @a last) of a file
+     * @return disk block indexes, valid until the next call in the same thread
+     */
+    [[nodiscard]]
+    auto file_blocks(const Descriptor& descriptor, std::size_t first, std::size_t last) const
+        -> const std::vector<std::size_t>&;
+
+    /**
+     * @brief Allocate data blocks [@a first, @a last) of a file, as much as possible
+     * @return number of data blocks file has
+     */
+    auto extend_file(Descriptor& descriptor, std::size_t first, std::size_t last) -> std::size_t;
+
+    /**
+     * @brief Write @a src at @a pos of inline file data, as much as fits in the descriptor
+     * @return number of bytes written
+     */
+    auto write_inline_data(Descriptor& descriptor, std::size_t pos, std::span<const std::byte> src) -> std::size_t;
+
+    /**
+     * @brief Move inline file data to a data block, so that file can grow past inline capacity
+     * @return false if disk is full
+     */
+    auto spill_inline_data(Descriptor& descriptor) -> bool;
+
+    /**
+     * @brief Free all data and indirect blocks of a file
+     */
+    void free_file_blocks(const Descriptor& descriptor);
+
+    /**
+     * @brief Calculate number of blocks for bitmap, so that every disk block could be described
+     * @return number of bitmap blocks
+     */
+    auto calculate_bitmap_blocks() const -> std::size_t;
+
+    /**
+     * @brief Recount free data blocks in every bitmap block
+     */
+    void count_free_blocks();
+
     /**
      * @brief Calculate number of blocks for metadata
      * @return number of metadata blocks
@@ -170,130 +371,154 @@ protected:
      */
     auto data_blocks_count() const noexcept -> std::size_t;
 
+    /**
+     * @brief Get range of bits describing data blocks in a bitmap block
+     * @param bitmap_block index of the bitmap block
+     * @return first and past-the-last bit in the bitmap block
+     */
+    auto data_bits(std::size_t bitmap_block) const noexcept -> std::pair<std::size_t, std::size_t>;
+
+    /**
+     * @brief Get count of free data blocks
+     * @return free data blocks count
+     */
+    auto free_blocks_count() const noexcept -> std::size_t;
+
 private:
+    /**
+     * @brief Buffers reused by block transfers, one set per thread so that transfers can run in parallel.
+     */
+    struct Scratch {
+        std::vector<std::size_t> batch_blocks;                  // Block indexes of a batched I/O request
+        std::vector<std::size_t> file_blocks;                   // Disk blocks of a file range being accessed
+        std::vector<std::span<std::byte>> read_batch;           // Destinations of a batched read
+        std::vector<std::span<const std::byte>> write_batch;    // Sources of a batched write
+    };
+
+    [[nodiscard]]
+    static auto scratch() noexcept -> Scratch&;
+
     std::unique_ptr<IO> _io;                              // I/O system
+    const std::size_t _bitmap_blocks;                     // Number of blocks of free-space bitmap
     const std::size_t _k;                                 // Size of metadata (naming according to task)
-    mutable std::vector<std::byte> _block_buffer;         // Buffer used to write/read to/from I/O
     std::vector<std::size_t> _descriptor_blocks_indexes;  // Indexes of blocks with descriptors
+    std::vector<Descriptor> _descriptors;                 // Resident descriptor table, loaded at mount
+    std::vector<bool> _dirty_descriptors;                 // Descriptors modified since the last flush
+    std::vector<std::size_t> _free_descriptors;           // Stack of free descriptors, rebuilt at mount
+    std::vector<std::size_t> _free_blocks;                // Summary of bitmap: free data blocks described by each bitmap block
+    std::size_t _free_blocks_total = 0u;                  // Free data blocks on disk
+    std::size_t _allocation_hint = 0u;                    // Bitmap position next allocation starts searching from
+    mutable std::mutex _metadata_mutex;                   // Guards bitmap, its summary and writes of descriptor table
 };
 
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::scratch() noexcept -> Scratch& {
+    thread_local Scratch buffers;
+    return buffers;
+}
+
+template <std::size_t BlockLength>
 template <class Type, class InputIt, class UnaryPredicate>
-auto Default::find_value_on_disk_blocks_if(InputIt begin, InputIt end, UnaryPredicate predicate) const
-    -> std::optional<Default::IOPosition>
+auto BasicDefault<BlockLength>::find_value_on_disk_blocks_if(InputIt begin, InputIt end, UnaryPredicate predicate) const
+    -> std::optional<IOPosition>
 {
-    static constexpr auto type_size = sizeof(Type);
-    const std::size_t block_length = _io->block_length();
-
-    std::deque<std::byte> accumulating_buffer;
-    std::size_t values_serialized = 0u;
-
-    for (auto it = begin; it != end; ++it) {
-        _io->read_block(*it, _block_buffer); // read a new block from disk
-        std::copy(
-                _block_buffer.begin(), _block_buffer.end(), std::back_inserter(accumulating_buffer)); // accumulate read buffer
-
-        while (type_size <= accumulating_buffer.size()) {
-            Type value{};
-            memcpy(&value, &*accumulating_buffer.begin(), type_size); // pain
-
-            if (predicate(value)) {
-                return {IOPosition::fromIndex(values_serialized * type_size, block_length)};
-            }
-            ++values_serialized;
-            accumulating_buffer.erase(
-                    accumulating_buffer.begin(),
-                    accumulating_buffer.begin() + type_size);
+    for (auto cursor = BlockCursor<Type>{std::as_const(*_io), {begin, end}, 0u, block_length()}; !cursor.done(); cursor.next()) {
+        if (predicate(cursor.get())) {
+            return {IOPosition::fromIndex(cursor.offset(), block_length())};
         }
     }
 
     return std::nullopt;
 }
 
+template <std::size_t BlockLength>
 template <class InputIt>
-auto Default::read_bytes_from_disk_blocks(
+auto BasicDefault<BlockLength>::read_bytes_from_disk_blocks(
         std::span<std::byte> bytes, InputIt begin, InputIt end, IOPosition position) const -> std::size_t
 {
-    if (end - begin < position.block + 1) { // invalid input data case
+    if (end - begin < position.block + 1 || bytes.empty()) { // invalid input data case
         return 0u;
     }
 
-    auto it = begin + position.block;
-    _io->read_block(*(it++), _block_buffer);
-    std::size_t bytes_read = std::min(bytes.size(), _block_buffer.size() - position.byte);
-
-    std::copy_n(_block_buffer.begin() + position.byte,
-                bytes_read,
-                bytes.begin()); // put bytes from a first read block
-
-    while (it != end && bytes.size() > bytes_read) {
-        _io->read_block(*(it++), _block_buffer);
-        std::size_t bytes_to_read = std::min(bytes.size() - bytes_read, _block_buffer.size());
-        std::copy_n(_block_buffer.begin(),
-                    bytes_to_read,
-                    bytes.begin() + bytes_read); // continue filling the tail of bytes from read block
-        bytes_read += bytes_to_read;
+    const auto block_length = this->block_length();
+    const auto blocks_to_read = std::min<std::size_t>(
+            end - begin - position.block,
+            (position.byte + bytes.size() + block_length - 1) / block_length);
+    auto& buffers = scratch();
+    buffers.batch_blocks.assign(begin + position.block, begin + position.block + blocks_to_read);
+
+    const auto head_bytes = std::min(bytes.size(), block_length - position.byte);
+    buffers.read_batch.clear();
+    buffers.read_batch.push_back(bytes.first(head_bytes)); // first block may start in the middle, IO reads just that range
+    for (auto offset = head_bytes; offset < bytes.size(); offset += block_length) {
+        buffers.read_batch.push_back(bytes.subspan(offset, std::min(block_length, bytes.size() - offset))); // the rest go straight to bytes
     }
-    return bytes_read;
+
+    _io->read_blocks(buffers.batch_blocks, buffers.read_batch, position.byte);
+    return std::min(bytes.size(), blocks_to_read * block_length - position.byte);
 }
 
+template <std::size_t BlockLength>
 template <class Type, class InputIt>
-auto Default::read_value_from_disk_blocks(InputIt begin, InputIt end, Default::IOPosition position) const
+auto BasicDefault<BlockLength>::read_value_from_disk_blocks(InputIt begin, InputIt end, IOPosition position) const
         -> std::optional<Type>
 {
-    static constexpr auto type_size = sizeof(Type);
-    std::vector<std::byte> serialized_value(type_size);
-
-    const auto bytes_read = read_bytes_from_disk_blocks(serialized_value, begin, end, position);
-
-    if (bytes_read < type_size) {
+    const auto cursor = BlockCursor<Type>{
+            std::as_const(*_io), {begin, end}, position.block * block_length() + position.byte, block_length()};
+    if (cursor.done()) {
         return std::nullopt;
     }
-
-    Type value{};
-    memcpy(&value, &*serialized_value.begin(), type_size); // pain again
-    return {value};
+    return {cursor.get()};
 }
 
+template <std::size_t BlockLength>
 template <class InputIt>
-auto Default::write_bytes_to_disk_blocks(std::span<const std::byte> bytes, InputIt begin, InputIt end, Default::IOPosition position) -> std::size_t {
-    if (end - begin < position.block + 1) { // invalid input data case
+auto BasicDefault<BlockLength>::write_bytes_to_disk_blocks(std::span<const std::byte> bytes, InputIt begin, InputIt end, IOPosition position) -> std::size_t {
+    if (end - begin < position.block + 1 || bytes.empty()) { // invalid input data case
         return 0u;
     }
 
-    auto it = begin + position.block;
-    _io->read_block(*it, _block_buffer);
-    std::size_t bytes_written = std::min(bytes.size(), _block_buffer.size() - position.byte);
-    std::copy_n(bytes.begin(),
-                bytes_written,
-                _block_buffer.begin() + position.byte); // fill the first block of a slot for a value
-    _io->write_block(*(it++), std::span{_block_buffer});
-
-    while (it != end && bytes.size() > bytes_written) {
-        _io->read_block(*it, _block_buffer);
-        const auto bytes_to_rewrite = std::min(bytes.size() - bytes_written, _block_buffer.size());
-        std::copy_n(bytes.begin() + bytes_written,
-                    bytes_to_rewrite,
-                    _block_buffer.begin()); // continue filling the tail of serialized value into its slot
-        bytes_written += bytes_to_rewrite;
-        _io->write_block(*(it++), _block_buffer);
+    const auto block_length = this->block_length();
+    const auto blocks_to_write = std::min<std::size_t>(
+            end - begin - position.block,
+            (position.byte + bytes.size() + block_length - 1) / block_length);
+    auto& buffers = scratch();
+    buffers.batch_blocks.assign(begin + position.block, begin + position.block + blocks_to_write);
+
+    const auto head_bytes = std::min(bytes.size(), block_length - position.byte);
+    buffers.write_batch.clear();
+    buffers.write_batch.push_back(bytes.first(head_bytes)); // first block may be patched in the middle without reading it
+    for (auto offset = head_bytes; offset < bytes.size(); offset += block_length) {
+        buffers.write_batch.push_back(bytes.subspan(offset, std::min(block_length, bytes.size() - offset))); // shorter tail overwrites only block prefix
     }
 
-    return bytes_written;
+    _io->write_blocks(buffers.batch_blocks, buffers.write_batch, position.byte);
+    return std::min(bytes.size(), blocks_to_write * block_length - position.byte);
 }
 
+template <std::size_t BlockLength>
 template <class Type, class InputIt>
-auto Default::write_value_to_disk_blocks(Type value, InputIt begin, InputIt end, Default::IOPosition position)
+auto BasicDefault<BlockLength>::write_value_to_disk_blocks(Type value, InputIt begin, InputIt end, IOPosition position)
     -> std::size_t
 {
-    if (end - begin < position.block + 1) { // invalid input data case
+    auto cursor = BlockCursor<Type, IO>{
+            *_io, {begin, end}, position.block * block_length() + position.byte, block_length()};
+    if (cursor.done()) { // invalid input data case
         return 0u;
     }
+    cursor.put(value);
+    return Packed<Type>::size;
+}
 
-    static constexpr auto type_size = sizeof(Type);
+using Default = BasicDefault<dynamic_block_length>;
 
-    std::vector<std::byte> serialized_value(type_size);
-    memcpy(&*serialized_value.begin(), &value, type_size); // and again
+extern template class BasicDefault<dynamic_block_length>;
+extern template class BasicDefault<64u>;
+extern template class BasicDefault<128u>;
+extern template class BasicDefault<256u>;
+extern template class BasicDefault<512u>;
+extern template class BasicDefault<1024u>;
+extern template class BasicDefault<2048u>;
+extern template class BasicDefault<4096u>;
 
-    return write_bytes_to_disk_blocks(serialized_value, begin, end, position);
-}
 } // namespace fs::core
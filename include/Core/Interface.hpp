@@ -1,7 +1,10 @@
 #pragma once
 
  #include <Entity.hpp>
+#include <Core/PageCache.hpp>
+#include <IO.hpp>
 
+#include <functional>
 #include <string_view>
 #include <optional>
 #include <memory>
@@ -25,6 +28,12 @@ struct Interface
      */
     using Ptr = std::unique_ptr<Interface>;
 
+    /**
+     * @brief Callback receiving directory entries one by one, returns false to stop iteration.
+     *        Entry is valid only during the call.
+     */
+    using EntryVisitor = std::function<bool(const Directory::Entry&)>;
+
     /**
      * @brief Virtual destructor, as required.
      */
@@ -52,7 +61,7 @@ struct Interface
                        std::span<const std::byte> src) -> std::size_t = 0;
 
     /**
-     * @brief Create new file in directory.
+     * @brief Create new file or, if @a file is a directory, empty subdirectory in directory.
      */
     virtual auto create(Directory::index_type dir, const File& file) -> Directory::Entry::index_type = 0;
 
@@ -64,20 +73,55 @@ struct Interface
         -> std::optional<Directory::Entry::index_type> = 0;
 
     /**
-     * @brief Remove file from the directory.
+     * @brief Check whether file is a directory, which other files can be created in.
+     */
+    [[nodiscard]]
+    virtual auto is_directory(Directory::Entry::index_type index) const -> bool = 0;
+
+    /**
+     * @brief Remove file from the directory. Directory has to be empty to be removed.
      */
     virtual void remove(Directory::index_type dir, Directory::Entry::index_type index) = 0;
 
     /**
-     * @brief List all entries in directory sorted by name.
+     * @brief List all entries in directory sorted by name. Listing is a snapshot, it does not change
+     *        when directory does, and may be shared with other callers.
+     */
+    [[nodiscard]]
+    virtual auto get(Directory::index_type dir) const -> std::shared_ptr<const Directory> = 0;
+
+    /**
+     * @brief Stream entries of directory whose names start with @a prefix to @a visitor without building a listing.
+     *        Order of entries is unspecified.
+     */
+    virtual void for_each_entry(Directory::index_type dir, std::string_view prefix, const EntryVisitor& visitor) const = 0;
+
+    /**
+     * @brief Save content for further restoring into specified file in chosen image format.
+     */
+    virtual void save(std::string_view path, IO::Format format) = 0;
+
+    /**
+     * @brief Write data and metadata held in memory to I/O system.
+     */
+    virtual void flush() = 0;
+
+    /**
+     * @brief Simulated time and head movements spent by I/O system since the last reset.
+     */
+    [[nodiscard]]
+    virtual auto io_stats() const -> io::LatencyModel::Stats = 0;
+
+    /**
+     * @brief Hit, miss and eviction counters of page cache since the last reset, if core has one.
      */
     [[nodiscard]]
-    virtual auto get(Directory::index_type dir) const -> std::optional<Directory> = 0;
+    virtual auto cache_stats() const -> std::optional<PageCache::Stats> = 0;
 
     /**
-     * @brief Save content for further restoring into specified file.
+     * @brief Start counting statistics anew.
      */
-    virtual void save(std::string_view path) const = 0;
+    virtual void reset_stats() = 0;
 };
 
 } // namespace fs::core
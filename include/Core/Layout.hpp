@@ -0,0 +1,210 @@
+#pragma once
+
+#include <Packed.hpp>
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace fs::core {
+
+/**
+ * @brief Version of on-disk layout, stored in superblock. Images of other versions are refused.
+ */
+inline constexpr std::uint16_t layout_version = 3u;
+
+/**
+ * @brief Block pointer as stored on disk.
+ */
+using block_pointer_type = std::uint32_t;
+
+struct UtilityStruct {
+    bool is_occupied = true;
+
+    friend auto operator==(const UtilityStruct&, const UtilityStruct&) -> bool = default;
+};
+
+/**
+ * @brief Header at the beginning of block 0, free-space bitmap follows it.
+ */
+struct Superblock {
+    static constexpr std::array<char, 4> expected_magic{'F', 'S', 'L', 'B'};
+
+    std::array<char, 4> magic = expected_magic;
+    std::uint16_t version = layout_version;
+};
+
+/**
+ * @brief On-disk file descriptor. First data blocks are referenced directly, next ones through
+ *        an indirect block of pointers and the rest through a double indirect block of pointers to
+ *        indirect blocks. Zero pointer means no block, as block 0 always belongs to the bitmap.
+ *        Small file keeps its bytes inline in place of the pointers and has no blocks at all.
+ */
+struct Descriptor : UtilityStruct {
+    static constexpr std::size_t direct_blocks = 3u;
+    static constexpr std::size_t inline_capacity = 51u; // fills packed descriptor up to 64 bytes
+
+    std::size_t length = 0u;
+    std::array<std::size_t, direct_blocks> blocks{};  // first data blocks
+    std::size_t indirect = 0u;                        // block of pointers to the following data blocks
+    std::size_t double_indirect = 0u;                 // block of pointers to indirect blocks
+    std::size_t entry_slot = 0u;                      // slot of the directory entry referring to the file
+    bool is_inline = false;                           // file data is kept in the descriptor, not in blocks
+    bool is_directory = false;                        // file is a hash table of directory entries
+    std::array<std::byte, inline_capacity> data{};    // file data when it is inline
+
+    [[nodiscard]]
+    static constexpr auto pointers_per_block(std::size_t block_size) noexcept -> std::size_t {
+        return block_size / sizeof(block_pointer_type);
+    }
+
+    [[nodiscard]]
+    static constexpr auto max_blocks(std::size_t block_size) noexcept -> std::size_t {
+        const auto pointers = pointers_per_block(block_size);
+        return direct_blocks + pointers + pointers * pointers;
+    }
+
+    [[nodiscard]]
+    auto blocks_allocated(std::size_t block_size) const noexcept -> std::size_t {
+        return is_inline ? 0u : (length + block_size - 1) / block_size;
+    }
+
+    friend auto operator==(const Descriptor&, const Descriptor&) -> bool = default;
+};
+
+/**
+ * @brief Slot of on-disk directory, which is an open-addressing hash table of entries keyed by name.
+ *        Removed entry keeps its name as a tombstone, slot that was never used has empty name.
+ */
+struct DirectoryEntry : UtilityStruct {
+    static constexpr std::size_t max_filename_length = 20u;
+
+    std::array<char, max_filename_length> name;
+    std::size_t name_length;
+    std::size_t descriptor_index = 0u;
+};
+
+} // namespace fs::core
+
+namespace fs {
+
+// Packed lives in fs, so specializations for core structures are declared there
+
+template <>
+struct Packed<core::Superblock> {
+    using Superblock = core::Superblock;
+
+    static constexpr std::size_t magic_offset = 0u;
+    static constexpr std::size_t version_offset = magic_offset + Superblock::expected_magic.size();
+    static constexpr std::size_t size = version_offset + sizeof(std::uint16_t) + sizeof(std::uint16_t); // reserved field
+
+    static constexpr void encode(const Superblock& superblock, std::span<std::byte, size> to) noexcept {
+        std::fill(to.begin(), to.end(), std::byte{0});
+        std::transform(superblock.magic.begin(), superblock.magic.end(), to.begin() + magic_offset,
+                       [](char c) { return static_cast<std::byte>(c); });
+        layout::store(to, version_offset, superblock.version);
+    }
+
+    static constexpr auto decode(std::span<const std::byte, size> from) noexcept -> Superblock {
+        Superblock superblock;
+        std::transform(from.begin() + magic_offset, from.begin() + version_offset, superblock.magic.begin(),
+                       [](std::byte b) { return static_cast<char>(b); });
+        superblock.version = layout::load<std::uint16_t>(from, version_offset);
+        return superblock;
+    }
+};
+
+template <>
+struct Packed<core::Descriptor> {
+    using Descriptor = core::Descriptor;
+    using block_pointer_type = core::block_pointer_type;
+
+    static constexpr std::uint8_t occupied_flag = 1u;
+    static constexpr std::uint8_t inline_flag = 2u;
+    static constexpr std::uint8_t directory_flag = 4u;
+
+    static constexpr std::size_t flags_offset = 0u;
+    static constexpr std::size_t length_offset = flags_offset + sizeof(std::uint8_t);
+    static constexpr std::size_t entry_slot_offset = length_offset + sizeof(std::uint64_t);
+    static constexpr std::size_t blocks_offset = entry_slot_offset + sizeof(std::uint32_t); // pointers or inline data start here
+    static constexpr std::size_t indirect_offset = blocks_offset + Descriptor::direct_blocks * sizeof(block_pointer_type);
+    static constexpr std::size_t double_indirect_offset = indirect_offset + sizeof(block_pointer_type);
+    static constexpr std::size_t size = blocks_offset + Descriptor::inline_capacity;
+
+    static_assert(double_indirect_offset + sizeof(block_pointer_type) <= size, "pointers must fit in inline data area");
+
+    static constexpr void encode(const Descriptor& descriptor, std::span<std::byte, size> to) noexcept {
+        layout::store(to, flags_offset, static_cast<std::uint8_t>((descriptor.is_occupied ? occupied_flag : 0u)
+                                                                  | (descriptor.is_inline ? inline_flag : 0u)
+                                                                  | (descriptor.is_directory ? directory_flag : 0u)));
+        layout::store(to, length_offset, static_cast<std::uint64_t>(descriptor.length));
+        layout::store(to, entry_slot_offset, static_cast<std::uint32_t>(descriptor.entry_slot));
+        if (descriptor.is_inline) {
+            std::copy(descriptor.data.begin(), descriptor.data.end(), to.begin() + blocks_offset);
+            return;
+        }
+        std::fill(to.begin() + blocks_offset, to.end(), std::byte{0});
+        for (std::size_t i = 0u; i < Descriptor::direct_blocks; ++i) {
+            layout::store(to, blocks_offset + i * sizeof(block_pointer_type),
+                          static_cast<block_pointer_type>(descriptor.blocks[i]));
+        }
+        layout::store(to, indirect_offset, static_cast<block_pointer_type>(descriptor.indirect));
+        layout::store(to, double_indirect_offset, static_cast<block_pointer_type>(descriptor.double_indirect));
+    }
+
+    static constexpr auto decode(std::span<const std::byte, size> from) noexcept -> Descriptor {
+        const auto flags = layout::load<std::uint8_t>(from, flags_offset);
+        Descriptor descriptor{{.is_occupied = (flags & occupied_flag) != 0u}};
+        descriptor.is_directory = (flags & directory_flag) != 0u;
+        descriptor.length = layout::load<std::uint64_t>(from, length_offset);
+        descriptor.entry_slot = layout::load<std::uint32_t>(from, entry_slot_offset);
+        if ((flags & inline_flag) != 0u) {
+            descriptor.is_inline = true;
+            descriptor.length = std::min<std::size_t>(descriptor.length, Descriptor::inline_capacity);
+            std::copy(from.begin() + blocks_offset, from.end(), descriptor.data.begin());
+            return descriptor;
+        }
+        for (std::size_t i = 0u; i < Descriptor::direct_blocks; ++i) {
+            descriptor.blocks[i] = layout::load<block_pointer_type>(from, blocks_offset + i * sizeof(block_pointer_type));
+        }
+        descriptor.indirect = layout::load<block_pointer_type>(from, indirect_offset);
+        descriptor.double_indirect = layout::load<block_pointer_type>(from, double_indirect_offset);
+        return descriptor;
+    }
+};
+
+template <>
+struct Packed<core::DirectoryEntry> {
+    using DirectoryEntry = core::DirectoryEntry;
+
+    static constexpr std::size_t flags_offset = 0u;
+    static constexpr std::size_t name_length_offset = flags_offset + sizeof(std::uint8_t);
+    static constexpr std::size_t name_offset = name_length_offset + sizeof(std::uint8_t);
+    static constexpr std::size_t descriptor_index_offset = name_offset + DirectoryEntry::max_filename_length;
+    static constexpr std::size_t size = descriptor_index_offset + sizeof(std::uint32_t);
+
+    static_assert(DirectoryEntry::max_filename_length <= UINT8_MAX, "name length is stored in one byte");
+
+    static constexpr void encode(const DirectoryEntry& entry, std::span<std::byte, size> to) noexcept {
+        layout::store(to, flags_offset, static_cast<std::uint8_t>(entry.is_occupied));
+        layout::store(to, name_length_offset, static_cast<std::uint8_t>(entry.name_length));
+        std::transform(entry.name.begin(), entry.name.end(), to.begin() + name_offset,
+                       [](char c) { return static_cast<std::byte>(c); });
+        layout::store(to, descriptor_index_offset, static_cast<std::uint32_t>(entry.descriptor_index));
+    }
+
+    static constexpr auto decode(std::span<const std::byte, size> from) noexcept -> DirectoryEntry {
+        DirectoryEntry entry{{.is_occupied = (layout::load<std::uint8_t>(from, flags_offset) & 1u) != 0u}};
+        entry.name_length = std::min<std::size_t>(layout::load<std::uint8_t>(from, name_length_offset),
+                                                  DirectoryEntry::max_filename_length);
+        std::transform(from.begin() + name_offset, from.begin() + descriptor_index_offset, entry.name.begin(),
+                       [](std::byte b) { return static_cast<char>(b); });
+        entry.descriptor_index = layout::load<std::uint32_t>(from, descriptor_index_offset);
+        return entry;
+    }
+};
+
+} // namespace fs
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <Entity.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fs::core {
+
+/**
+ * @brief Bounded cache of file pages shared by all files, one page per block of file data.
+ *        Replacement policy is chosen at construction: LRU, CLOCK (second chance) or ARC,
+ *        which balances recently and frequently used pages using history of evicted keys.
+ */
+class PageCache
+{
+public:
+    enum class Policy { lru, clock, arc };
+
+    struct Key
+    {
+        Directory::Entry::index_type file;
+        std::size_t page;                   // index of the page in the file
+
+        friend auto operator==(const Key&, const Key&) -> bool = default;
+    };
+
+    struct Page
+    {
+        std::vector<std::byte> data;
+        std::size_t length = 0u;            // valid bytes from the beginning of the page, shorter than data at the end of file
+    };
+
+    struct Stats
+    {
+        std::size_t hits = 0u;
+        std::size_t misses = 0u;
+        std::size_t evictions = 0u;
+    };
+
+    /**
+     * @brief Create cache holding at most @a capacity pages.
+     */
+    PageCache(std::size_t capacity, Policy policy);
+
+    /**
+     * @brief Look page up, counting hit or miss and updating its recency.
+     */
+    [[nodiscard]]
+    auto find(const Key& key) -> Page*;
+
+    /**
+     * @brief Look page up leaving statistics and replacement order intact.
+     */
+    [[nodiscard]]
+    auto peek(const Key& key) -> Page*;
+
+    /**
+     * @brief Put page into cache replacing the one with the same key.
+     * @return page evicted to make room for it
+     */
+    auto insert(const Key& key, Page page) -> std::optional<std::pair<Key, Page>>;
+
+    /**
+     * @brief Drop all pages of @a file, e. g. when it is removed and its index is reused.
+     */
+    void erase_file(Directory::Entry::index_type file);
+
+    [[nodiscard]]
+    auto size() const noexcept -> std::size_t;
+
+    [[nodiscard]]
+    auto capacity() const noexcept -> std::size_t;
+
+    [[nodiscard]]
+    auto policy() const noexcept -> Policy;
+
+    [[nodiscard]]
+    auto stats() const noexcept -> const Stats&;
+
+    void reset_stats() noexcept;
+
+private:
+    struct KeyHash
+    {
+        auto operator()(const Key& key) const noexcept -> std::size_t {
+            return std::hash<std::size_t>{}(key.page) ^ (std::hash<Directory::Entry::index_type>{}(key.file) * 0x9e3779b97f4a7c15u);
+        }
+    };
+
+    using Queue = std::list<Key>;
+
+    struct Entry
+    {
+        Page page;
+        Queue::iterator position;           // position in _recent or _frequent
+        bool frequent;                      // page was hit since it got into cache, only ARC uses it
+        bool referenced;                    // reference bit, only CLOCK uses it
+    };
+
+    struct Ghost
+    {
+        Queue::iterator position;           // position in _recent_ghosts or _frequent_ghosts
+        bool frequent;
+    };
+
+    /**
+     * @brief Move key to the most recently used end of @a to queue.
+     */
+    static void move_to_front(Queue& from, Queue::iterator position, Queue& to);
+
+    /**
+     * @brief Evict a page to make room for a new one.
+     * @param frequent_ghost_hit new key was found in history of frequently used pages (ARC only)
+     */
+    auto evict(bool frequent_ghost_hit) -> std::pair<Key, Page>;
+
+    /**
+     * @brief Evict least recently used page of @a queue, remembering its key in @a ghosts if it is given.
+     */
+    auto evict_from(Queue& queue, Queue* ghosts, bool frequent) -> std::pair<Key, Page>;
+
+    /**
+     * @brief Forget the oldest key of ghost @a queue.
+     */
+    void drop_ghost(Queue& queue);
+
+    std::size_t _capacity;
+    Policy _policy;
+    std::unordered_map<Key, Entry, KeyHash> _pages;
+    std::unordered_map<Key, Ghost, KeyHash> _ghosts;        // keys of recently evicted pages (ARC only)
+    Queue _recent;                                          // LRU order for LRU, clock order for CLOCK, T1 for ARC
+    Queue _frequent;                                        // T2 for ARC
+    Queue _recent_ghosts;                                   // B1 for ARC
+    Queue _frequent_ghosts;                                 // B2 for ARC
+    std::size_t _recent_target = 0u;                        // ARC target size of _recent
+    Stats _stats;
+};
+
+} // namespace fs::core
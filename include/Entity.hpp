@@ -10,6 +10,7 @@ struct File
 {
     std::size_t size;
     std::string name;
+    bool is_directory = false;
 };
 
 struct Directory : File
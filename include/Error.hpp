@@ -11,7 +11,7 @@ namespace fs {
     {
         template<typename F, typename... Args>
         explicit(sizeof...(Args) == 0) Error(F&& format, Args&&... args) :
-                runtime_error{fmt::format(std::forward<F>(format), std::forward<Args>(args)...)}
+                runtime_error{fmt::vformat(std::forward<F>(format), fmt::make_format_args(args...))}
         { }
     };
 }
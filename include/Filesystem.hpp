@@ -4,14 +4,24 @@
 #include <Entity.hpp>
 #include <Error.hpp>
 
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
+#include <string_view>
 #include <utility>
+#include <vector>
 #include <span>
 
 namespace fs {
 
 /**
- * @brief Old good file system with UNIX-like interface.
+ * @brief Old good file system with UNIX-like interface. Files are named by slash-separated
+ *        paths, absolute or relative to the current directory, with "." and ".." components.
+ *        Methods may be called from many threads: reads and writes of different open files run
+ *        in parallel, lookups share the namespace, while changes of it wait for exclusive access.
  */
 class Filesystem
 {
@@ -40,14 +50,29 @@ public:
     void destroy(std::string_view name);
 
     /**
-     * @brief Opens file with name @a name
-     * @return Index of opened file
+     * @brief Creates empty directory with name @a name
+     */
+    void make_directory(std::string_view name);
+
+    /**
+     * @brief Removes empty directory with name @a name
+     */
+    void remove_directory(std::string_view name);
+
+    /**
+     * @brief Makes directory with name @a name the current one
+     */
+    void change_directory(std::string_view name);
+
+    /**
+     * @brief Opens file with name @a name. File may be opened many times, every handle has its own position.
+     * @return Index of handle of opened file, stale index of a closed handle is rejected
      */
     [[nodiscard]]
     auto open(std::string_view name) -> file_index_type;
 
     /**
-     * @brief Closes file with index @a index
+     * @brief Closes handle with index @a index
      */
     void close(file_index_type index);
 
@@ -71,20 +96,152 @@ public:
     void lseek(file_index_type index, std::size_t pos);
 
     /**
-     * @brief Returns all files in directory
+     * @brief Reads dst.size() bytes at @a pos from file with index @a index to @a dst, leaving current position intact.
+     *        Positional reads of a file, through one handle or many, run in parallel.
+     * @return Amount of read bytes (<= dst.size())
+     */
+    [[nodiscard]]
+    auto pread(file_index_type index, std::size_t pos, std::span<std::byte> dst) const -> std::size_t;
+
+    /**
+     * @brief Writes src.size() bytes from @a src at @a pos to file with index @a index, leaving current position intact
+     * @return Amount of written bytes (<= src.size())
+     */
+    [[nodiscard]]
+    auto pwrite(file_index_type index, std::size_t pos, std::span<const std::byte> src) -> std::size_t;
+
+    /**
+     * @brief Returns all files in current directory, as a snapshot which later changes do not affect
      */
     [[nodiscard]]
-    auto directory() const -> std::vector<File>;
+    auto directory() const -> std::shared_ptr<const Directory>;
+
+    /**
+     * @brief Passes files of current directory whose names start with @a prefix to @a visitor one by one,
+     *        until it returns false. Nothing is copied, so checking a few names of a huge directory is cheap.
+     *        Namespace stays locked for reading meanwhile, so visitor must not call this filesystem at all:
+     *        taking the lock again on the same thread may deadlock behind a waiting writer.
+     *        Collect what is needed and open or read the files after the walk.
+     */
+    void for_each_file(std::string_view prefix, const core::Interface::EntryVisitor& visitor) const;
+
+    /**
+     * @brief Write all data cached in memory to disk.
+     */
+    void flush();
 
     /**
      * @brief Save filesystem content for further restoring into specified file.
      */
-    void save(std::string_view path);
+    void save(std::string_view path, IO::Format format = IO::Format::raw);
+
+    /**
+     * @brief Returns simulated time and head movements spent on disk since mount or the last reset
+     */
+    [[nodiscard]]
+    auto io_stats() const -> io::LatencyModel::Stats;
+
+    /**
+     * @brief Returns page cache counters since mount or the last reset, nullopt if file data is not cached
+     */
+    [[nodiscard]]
+    auto cache_stats() const -> std::optional<core::PageCache::Stats>;
+
+    /**
+     * @brief Starts counting statistics anew
+     */
+    void reset_stats();
 
 private:
+    /**
+     * @brief Opened file, shared by all its handles. Reads lock it shared, writes and closing lock it exclusively.
+     */
+    struct OpenFile
+    {
+        std::shared_mutex mutex;
+        std::size_t handles = 0;        // open handles of the file, guarded by its shard
+    };
+
+    /**
+     * @brief Handle of opened file with its own position.
+     */
+    struct Handle
+    {
+        std::mutex mutex;               // serializes sequential operations through the handle, guards position
+        std::size_t position = 0;
+        std::size_t slot;               // slot of the handle in open file table
+        Directory::Entry::index_type file;
+        std::shared_ptr<OpenFile> open_file;
+        bool is_open = true;            // cleared under open file lock, as other threads may still hold the handle
+    };
+
+    /**
+     * @brief Entry of open file table. Generation grows whenever slot is freed, so index of a closed
+     *        handle does not refer to the handle that reuses its slot.
+     */
+    struct Slot
+    {
+        std::uint32_t generation = 0;
+        std::shared_ptr<Handle> handle; // null if slot is free
+    };
+
+    /**
+     * @brief Part of open file table. Handles of a file are placed in the shard of the file,
+     *        so that opening and looking handles up rarely contend.
+     */
+    struct Shard
+    {
+        std::mutex mutex;
+        std::vector<Slot> slots;        // slot i of shard s has index i * oft_shards + s
+        std::vector<std::size_t> free_slots;
+        std::unordered_map<Directory::Entry::index_type, std::shared_ptr<OpenFile>> files;
+    };
+
+    static constexpr std::size_t oft_shards = 16;
+    static constexpr std::size_t generation_shift = 32;    // handle index keeps slot in low bits, generation in high ones
+
+    /**
+     * @brief Find handle with index @a index
+     */
+    [[nodiscard]]
+    auto find_handle(file_index_type index) const -> std::shared_ptr<Handle>;
+
+    /**
+     * @brief Read or write file of @a handle at @a pos under lock of the file, caller holds namespace lock
+     */
+    [[nodiscard]]
+    auto pread(const Handle& handle, std::size_t pos, std::span<std::byte> dst) const -> std::size_t;
+
+    [[nodiscard]]
+    auto pwrite(const Handle& handle, std::size_t pos, std::span<const std::byte> src) -> std::size_t;
+
+    /**
+     * @brief Free slot of @a handle in @a shard, caller holds shard lock
+     */
+    static void release_slot(Shard& shard, const Handle& handle);
+
+    /**
+     * @brief Drop all files from open file table, caller holds namespace lock exclusively
+     */
+    void close_all();
+
+    /**
+     * @brief Follow directories of @a path starting from the current one
+     * @return directories from root to the one @a path leads to
+     */
+    [[nodiscard]]
+    auto walk(std::string_view path) const -> std::vector<Directory::index_type>;
+
+    /**
+     * @brief Split @a path into directory it leads to and name of the last component
+     */
+    [[nodiscard]]
+    auto resolve(std::string_view path) const -> std::pair<Directory::index_type, std::string_view>;
+
     core::Interface::Ptr _core;
-    const Directory::index_type _cd = core::Interface::kRoot;
-    mutable std::unordered_map<Directory::Entry::index_type, std::size_t> _oft;  // maps file indices to current positions in file
+    std::vector<Directory::index_type> _cwd{core::Interface::kRoot};  // directories from root to the current one
+    mutable std::shared_mutex _namespace;                              // shared by file operations and lookups, exclusive for changes of namespace
+    mutable std::array<Shard, oft_shards> _oft;                        // maps file indices to open files
 };
 
 } // namespace fs
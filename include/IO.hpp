@@ -1,14 +1,45 @@
 #pragma once
 
-#include <vector>
+#include <IO/LatencyModel.hpp>
+#include <IO/Scheduler.hpp>
+
+#include <atomic>
 #include <span>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <iosfwd>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace fs {
 
+    /**
+     * @brief Simulated disk. Block transfers and their accounting are serialized, as a disk serves
+     *        one request at a time, so IO can be shared by threads. Taking a view with block is accounted
+     *        the same way, but bytes behind views are not synchronized: threads must not patch the same
+     *        block through them concurrently.
+     */
     class IO {
     public:
+        /**
+         * @brief Storage used for disk content.
+         */
+        enum class Backend {
+            memory,  // disk is held in process memory, image file is read on load and rewritten on save
+            mapped,  // image file is memory-mapped, changes go to the image and saving back to it flushes dirty pages
+        };
+
+        /**
+         * @brief Disk image format, detected automatically on load.
+         */
+        enum class Format {
+            raw,      // header followed by every block as is
+            compact,  // versioned; zero blocks are elided, chunks of blocks are compressed, chunk table allows random access
+        };
+
         /**
          *  @brief Constructs IO with disk, where #ncyl is the number of cylinders, #ntracks is the number of tracks per cylinder,
          *         #nsectors is the number of sectors(physical blocks) per track and #sector_length is the number of bytes per sector
@@ -17,29 +48,165 @@ namespace fs {
 
         IO (std::size_t nblocks, std::size_t block_length);
 
+        IO (io::Geometry geometry, std::size_t block_length);
+
         /**
          *  @brief Reads data from nth disk block to writes to #to
          *  @return number of bytes read
          */
         auto read_block(std::size_t n, std::span<std::byte> to) const -> std::size_t;
 
+        /**
+         * @brief Reads data of nth disk block starting at byte #offset to #to
+         * @return number of bytes read, which stops at the end of the block
+         */
+        auto read_block(std::size_t n, std::size_t offset, std::span<std::byte> to) const -> std::size_t;
+
         /**
          * @brief Writes #bytes to nth disk block
          * @return number of bytes written
          */
         auto write_block(std::size_t n, std::span<const std::byte> bytes) -> std::size_t;
 
+        /**
+         * @brief Writes #bytes to nth disk block starting at byte #offset, the rest of the block is left intact
+         * @return number of bytes written, which stops at the end of the block
+         */
+        auto write_block(std::size_t n, std::size_t offset, std::span<const std::byte> bytes) -> std::size_t;
+
+        /**
+         * @brief Reads blocks #blocks[i] into #to[i] in a single request, each one as with read_block.
+         *        The first block is read from byte #offset, as a file range usually starts inside it.
+         * @return total number of bytes read
+         */
+        auto read_blocks(std::span<const std::size_t> blocks, std::span<const std::span<std::byte>> to,
+                         std::size_t offset = 0u) const -> std::size_t;
+
+        /**
+         * @brief Writes #bytes[i] to blocks #blocks[i] in a single request, each one as with write_block.
+         *        The first block is written from byte #offset, so it needs not be read and patched by caller.
+         * @return total number of bytes written
+         */
+        auto write_blocks(std::span<const std::size_t> blocks, std::span<const std::span<const std::byte>> bytes,
+                          std::size_t offset = 0u) -> std::size_t;
+
+        /**
+         * @brief Returns view of nth disk block, which allows to read and patch it in place.
+         *        Taking a view counts as one access of the block in latency model, so keep it for
+         *        all work on the block. View stays valid as long as IO object is alive.
+         *        Mutable view marks block as modified.
+         */
+        [[nodiscard]]
+        auto block(std::size_t n) -> std::span<std::byte>;
+
+        [[nodiscard]]
+        auto block(std::size_t n) const -> std::span<const std::byte>;
+
         [[nodiscard]]
         auto blocks_number() const noexcept -> std::size_t;
 
         [[nodiscard]]
         auto block_length() const noexcept -> std::size_t;
 
-        auto save(std::string_view path) const -> void;
-        static auto load(std::string_view path) -> std::optional<IO>;
+        [[nodiscard]]
+        auto backend() const noexcept -> Backend;
+
+        [[nodiscard]]
+        auto geometry() const noexcept -> const io::Geometry&;
+
+        /**
+         * @brief Replaces geometry used by latency model, it must describe the same number of blocks
+         */
+        void set_geometry(io::Geometry geometry);
+
+        /**
+         * @brief Replaces policy ordering requests of read_blocks/write_blocks (FIFO by default)
+         */
+        void set_scheduler(io::Scheduler::Ptr scheduler);
+
+        /**
+         * @brief Returns simulated time and head movements spent on block reads, writes and views
+         */
+        [[nodiscard]]
+        auto stats() const -> io::LatencyModel::Stats;
+
+        void reset_stats();
+
+        /**
+         * @brief Saves disk image to #path in #format. If raw disk image was loaded from or last saved to #path,
+         *        only blocks modified since then are rewritten (for mapped disk, modified pages are flushed).
+         */
+        auto save(std::string_view path, Format format = Format::raw) -> void;
+
+        /**
+         * @brief Restores disk from image at #path using chosen #backend
+         * @return restored disk or nullopt if image does not exist
+         */
+        static auto load(std::string_view path, Backend backend = Backend::memory) -> std::optional<IO>;
+
+        /**
+         * @brief Creates zero-filled image at #path with #nblocks blocks of #block_length bytes and maps it
+         */
+        static auto map(std::string_view path, std::size_t nblocks, std::size_t block_length) -> IO;
+
+        /**
+         * @brief Reads nth block of image at #path to #to without loading the whole disk
+         * @return number of bytes read
+         */
+        static auto read_image_block(std::string_view path, std::size_t n, std::span<std::byte> to) -> std::size_t;
 
     private:
-        std::vector<std::vector<std::byte>> _disk;
+        static constexpr std::size_t kArenaAlignment = 64;  // in-memory disk arena is aligned to cache line
+        static constexpr std::size_t kHeaderSize = 2 * sizeof(std::uint64_t);  // blocks number and block length
+
+        IO (std::string_view path, int fd, std::size_t nblocks, std::size_t block_length);
+
+        /**
+         * @brief Ranged transfers behind read_block/write_block, caller holds _mutex
+         */
+        auto read_range(std::size_t n, std::size_t offset, std::span<std::byte> to) const -> std::size_t;
+
+        auto write_range(std::size_t n, std::size_t offset, std::span<const std::byte> bytes) -> std::size_t;
+
+        /**
+         * @brief Start of nth block in arena, taking it is neither accounted nor marks block as modified
+         */
+        [[nodiscard]]
+        auto arena_block(std::size_t n) const noexcept -> std::byte*;
+
+        /**
+         * @brief Orders batch of #n requests to #blocks with scheduler, result is stored in _queue
+         */
+        void schedule(std::span<const std::size_t> blocks, std::size_t n) const;
+
+        /**
+         * @brief Rewrites only modified blocks of existing image at #path
+         * @return false if image does not match the disk
+         */
+        auto save_dirty(std::string_view path) -> bool;
+
+        void save_compact(std::string_view path) const;
+
+        /**
+         * @brief Restores disk from compact image, #file is positioned right after its header
+         */
+        static auto load_compact(std::istream& file, std::string_view path) -> IO;
+
+        struct ArenaDeleter {
+            std::size_t mapped_length;  // length of mapping which starts kHeaderSize bytes before arena, 0 if arena is allocated
+
+            void operator()(std::byte* arena) const noexcept;
+        };
+
+        std::size_t _nblocks;
+        std::size_t _block_length;
+        std::unique_ptr<std::byte[], ArenaDeleter> _arena;  // all disk blocks, stored contiguously
+        std::string _image_path;                            // image file disk was loaded from or saved to, backs mapped arena
+        std::vector<std::atomic<bool>> _dirty;              // blocks modified since disk was loaded or saved, marked by any thread
+        std::unique_ptr<std::mutex> _mutex;                 // serializes requests, held by pointer so IO stays movable
+        mutable io::LatencyModel _model;                    // simulated timing of block accesses
+        io::Scheduler::Ptr _scheduler;                      // orders batched requests
+        mutable std::vector<io::Request> _queue;            // requests of the current batch
     };
 
 } // namespace fs
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace fs::io {
+
+/**
+ * @brief Fast LZ77 block codec in the spirit of LZ4: greedy hash-table matching,
+ *        sequences of (literals, 16-bit offset, match length).
+ */
+namespace lz {
+
+/**
+ * @brief Appends compressed @a src to @a dst.
+ */
+void compress(std::span<const std::byte> src, std::vector<std::byte>& dst);
+
+/**
+ * @brief Decompresses @a src into @a dst, which must have exactly the original size.
+ * @return false if @a src is malformed or does not fill @a dst
+ */
+[[nodiscard]]
+auto decompress(std::span<const std::byte> src, std::span<std::byte> dst) -> bool;
+
+} // namespace lz
+} // namespace fs::io
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+namespace fs::io {
+
+/**
+ * @brief Physical layout of a disk. Logical blocks are numbered sector by sector
+ *        along a track, track by track within a cylinder, then cylinder by cylinder.
+ */
+struct Geometry
+{
+    struct Address
+    {
+        std::size_t cylinder;
+        std::size_t track;
+        std::size_t sector;
+    };
+
+    std::size_t cylinders;
+    std::size_t tracks;   // per cylinder
+    std::size_t sectors;  // per track
+
+    [[nodiscard]]
+    constexpr auto blocks_number() const noexcept -> std::size_t {
+        return cylinders * tracks * sectors;
+    }
+
+    [[nodiscard]]
+    constexpr auto address(std::size_t block) const noexcept -> Address {
+        return {.cylinder = block / (tracks * sectors),
+                .track = block / sectors % tracks,
+                .sector = block % sectors};
+    }
+};
+
+} // namespace fs::io
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <IO/Geometry.hpp>
+
+namespace fs::io {
+
+/**
+ * @brief Simulates time spent by a spinning disk to serve block accesses:
+ *        seek to the cylinder, wait for the sector to rotate under the head, transfer it.
+ */
+class LatencyModel
+{
+public:
+    struct Timing
+    {
+        double rotation_ms = 60'000. / 7'200;  // one revolution at 7200 rpm
+        double seek_settle_ms = 1.;            // fixed cost of any seek
+        double seek_per_cylinder_ms = 0.05;    // cost of crossing one cylinder
+    };
+
+    struct Stats
+    {
+        std::size_t accesses = 0u;
+        std::size_t seeks = 0u;
+        std::size_t cylinders_travelled = 0u;
+        double elapsed_ms = 0.;               // simulated time since the last reset
+    };
+
+    explicit LatencyModel(Geometry geometry) noexcept;
+
+    LatencyModel(Geometry geometry, Timing timing) noexcept;
+
+    /**
+     * @brief Moves head to #block, accounts seek, rotational and transfer time.
+     * @return time spent on the access
+     */
+    auto access(std::size_t block) noexcept -> double;
+
+    [[nodiscard]]
+    auto geometry() const noexcept -> const Geometry&;
+
+    [[nodiscard]]
+    auto head_cylinder() const noexcept -> std::size_t;
+
+    [[nodiscard]]
+    auto stats() const noexcept -> const Stats&;
+
+    void reset_stats() noexcept;
+
+private:
+    Geometry _geometry;
+    Timing _timing;
+    std::size_t _head_cylinder = 0u;
+    double _clock_ms = 0.;  // simulated time, defines angular position of the platter
+    Stats _stats;
+};
+
+} // namespace fs::io
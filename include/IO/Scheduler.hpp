@@ -0,0 +1,49 @@
+#pragma once
+
+#include <IO/Geometry.hpp>
+
+#include <memory>
+#include <span>
+
+namespace fs::io {
+
+/**
+ * @brief Queued block request.
+ */
+struct Request
+{
+    std::size_t block;
+    std::size_t slot;  // position of request in the submitted batch
+};
+
+/**
+ * @brief Policy deciding in which order queued block requests are served.
+ */
+struct Scheduler
+{
+    enum class Policy {
+        fifo,   // in order of submission
+        scan,   // elevator: sweep in current direction, then reverse
+        clook,  // sweep towards higher cylinders only, then jump back to the lowest request
+    };
+
+    using Ptr = std::unique_ptr<Scheduler>;
+
+    /**
+     * @brief Creates scheduler implementing @a policy.
+     */
+    static auto make(Policy policy) -> Ptr;
+
+    virtual ~Scheduler() = default;
+
+    /**
+     * @brief Reorders @a queue in place for a head positioned at @a head_cylinder.
+     *        Requests to the same block keep their relative order.
+     */
+    virtual void schedule(std::span<Request> queue, const Geometry& geometry, std::size_t head_cylinder) = 0;
+
+    [[nodiscard]]
+    virtual auto policy() const noexcept -> Policy = 0;
+};
+
+} // namespace fs::io
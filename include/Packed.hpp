@@ -0,0 +1,51 @@
+#pragma once
+
+#include <climits>
+#include <concepts>
+#include <cstddef>
+#include <span>
+
+namespace fs {
+namespace layout {
+
+/**
+ * @brief Store @a value at @a offset of @a bytes in little-endian order.
+ */
+template <std::unsigned_integral Integer>
+constexpr void store(std::span<std::byte> bytes, std::size_t offset, Integer value) noexcept {
+    for (std::size_t i = 0u; i < sizeof(Integer); ++i) {
+        bytes[offset + i] = static_cast<std::byte>(value >> (i * CHAR_BIT));
+    }
+}
+
+/**
+ * @brief Load little-endian value stored at @a offset of @a bytes.
+ */
+template <std::unsigned_integral Integer>
+constexpr auto load(std::span<const std::byte> bytes, std::size_t offset) noexcept -> Integer {
+    Integer value = 0u;
+    for (std::size_t i = 0u; i < sizeof(Integer); ++i) {
+        value |= static_cast<Integer>(static_cast<Integer>(bytes[offset + i]) << (i * CHAR_BIT));
+    }
+    return value;
+}
+
+} // namespace layout
+
+/**
+ * @brief Serialized form of on-disk structure: fixed @a size, little-endian fields, no padding.
+ *        Specialization provides size, encode and decode.
+ */
+template <class Type>
+struct Packed;
+
+template <class Type>
+concept PackedLayout = requires(const Type& value,
+                                std::span<std::byte, Packed<Type>::size> to,
+                                std::span<const std::byte, Packed<Type>::size> from)
+{
+    Packed<Type>::encode(value, to);
+    { Packed<Type>::decode(from) } -> std::same_as<Type>;
+};
+
+} // namespace fs
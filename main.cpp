@@ -9,9 +9,12 @@
 #include <string_view>
 #include <iostream>
 #include <charconv>
+#include <initializer_list>
+#include <utility>
 #include <optional>
 #include <string>
 #include <tuple>
+#include <vector>
 
 namespace {
 namespace detail {
@@ -56,6 +59,17 @@ namespace detail {
 
 } // namespace detail
 
+/**
+ * @brief Options applied to disks mounted by following in and im commands
+ */
+struct MountOptions
+{
+    fs::io::Scheduler::Policy scheduler = fs::io::Scheduler::Policy::fifo;
+    fs::core::PageCache::Policy cache = fs::core::PageCache::Policy::arc;
+    size_t cache_size = fs::core::default_cache_length;
+    fs::core::WritePolicy write = fs::core::WritePolicy::write_through;
+};
+
 struct cr
 {
     static constexpr std::string_view usage = "cr <name>";
@@ -205,6 +219,67 @@ struct wr
     }
 };
 
+struct pr
+{
+    static constexpr std::string_view usage = "pr <index> <pos> <count>";
+    static constexpr std::string_view description = "read a number of bytes <count> from the specified file <index> at <pos> without moving its current position";
+    static constexpr std::string_view output = "{} bytes read: {}";
+    static constexpr std::string_view cmd = "pr";
+
+    struct Input
+    {
+        size_t index;
+        size_t pos;
+        size_t count;
+
+        static constexpr auto args = std::tuple{
+            &Input::index,
+            &Input::pos,
+            &Input::count
+        };
+    };
+
+    auto operator()(const Input in, const fs::Filesystem& fs) const
+    {
+        std::string result;
+        result.resize(in.count);
+        const auto read = fs.pread(in.index, in.pos, {reinterpret_cast<std::byte*>(result.data()), result.size()});
+        result.resize(read);
+        return std::tuple{read, result};
+    }
+};
+
+struct pw
+{
+    static constexpr std::string_view usage = "pw <index> <pos> <char> <count>";
+    static constexpr std::string_view description = "write <count> number of <char>s into the specified file <index> at <pos> without moving its current position";
+    static constexpr std::string_view output = "{} bytes written";
+    static constexpr std::string_view cmd = "pw";
+
+    struct Input
+    {
+        size_t index;
+        size_t pos;
+        char ch;
+        size_t count;
+
+        static constexpr auto args = std::tuple{
+            &Input::index,
+            &Input::pos,
+            &Input::ch,
+            &Input::count
+        };
+    };
+
+    auto operator()(const Input in, fs::Filesystem& fs) const
+    {
+        std::string data;
+        data.assign(in.count, in.ch);
+        const auto written = fs.pwrite(in.index, in.pos, {reinterpret_cast<const std::byte*>(data.data()), data.size()});
+        return std::tuple{written};
+    }
+};
+
 struct sk
 {
     static constexpr std::string_view usage = "sk <index> <pos>";
@@ -233,15 +308,15 @@ struct sk
 struct dr
 {
     static constexpr std::string_view usage = "dr";
-    static constexpr std::string_view description = "directory: list the names of all files and their lengths";
+    static constexpr std::string_view description = "directory: list the names of all files in the current directory and their lengths, subdirectories end with /";
     static constexpr std::string_view output = "{}";
     static constexpr std::string_view cmd = "dr";
 
     auto operator()(const fs::Filesystem& fs) const
     {
         std::string result;
-        for (const auto& file : fs.directory()) {
-            fmt::format_to(std::back_inserter(result), "{} {}, ", file.name, file.size);
+        for (const auto& file : fs.directory()->entries) {
+            fmt::format_to(std::back_inserter(result), "{}{} {}, ", file.name, file.is_directory ? "/" : "", file.size);
         }
 
         /// Remove trailing ", "
@@ -253,6 +328,181 @@ struct dr
     }
 };
 
+struct ls
+{
+    static constexpr std::string_view usage = "ls <prefix>";
+    static constexpr std::string_view description = "list the names of files in the current directory starting with <prefix> and their lengths, in no particular order";
+    static constexpr std::string_view output = "{}";
+    static constexpr std::string_view cmd = "ls";
+
+    struct Input
+    {
+        std::string prefix;
+
+        static constexpr auto args = std::tuple{
+            &Input::prefix
+        };
+    };
+
+    auto operator()(const Input in, const fs::Filesystem& fs) const
+    {
+        std::string result;
+        fs.for_each_file(in.prefix, [&result](const auto& file) {
+            fmt::format_to(std::back_inserter(result), "{}{} {}, ", file.name, file.is_directory ? "/" : "", file.size);
+            return true;
+        });
+
+        /// Remove trailing ", "
+        if (!result.empty()) {
+            result.resize(result.size() - 2);
+        }
+
+        return std::tuple{result};
+    }
+};
+
+struct mkdir
+{
+    static constexpr std::string_view usage = "mkdir <path>";
+    static constexpr std::string_view description = "create a new empty directory <path>";
+    static constexpr std::string_view output = "directory {} created";
+    static constexpr std::string_view cmd = "mkdir";
+
+    struct Input
+    {
+        std::string path;
+
+        static constexpr auto args = std::tuple{
+            &Input::path
+        };
+    };
+
+    auto operator()(const Input in, fs::Filesystem& fs) const
+    {
+        fs.make_directory(in.path);
+        return std::tuple{in.path};
+    }
+};
+
+struct rmdir
+{
+    static constexpr std::string_view usage = "rmdir <path>";
+    static constexpr std::string_view description = "remove the empty directory <path>";
+    static constexpr std::string_view output = "directory {} removed";
+    static constexpr std::string_view cmd = "rmdir";
+
+    struct Input
+    {
+        std::string path;
+
+        static constexpr auto args = std::tuple{
+            &Input::path
+        };
+    };
+
+    auto operator()(const Input in, fs::Filesystem& fs) const
+    {
+        fs.remove_directory(in.path);
+        return std::tuple{in.path};
+    }
+};
+
+struct cd
+{
+    static constexpr std::string_view usage = "cd <path>";
+    static constexpr std::string_view description = "make directory <path> the current one; paths of other commands are relative to it unless they start with /";
+    static constexpr std::string_view output = "current directory is {}";
+    static constexpr std::string_view cmd = "cd";
+
+    struct Input
+    {
+        std::string path;
+
+        static constexpr auto args = std::tuple{
+            &Input::path
+        };
+    };
+
+    auto operator()(const Input in, fs::Filesystem& fs) const
+    {
+        fs.change_directory(in.path);
+        return std::tuple{in.path};
+    }
+};
+
+struct fl
+{
+    static constexpr std::string_view usage = "fl";
+    static constexpr std::string_view description = "flush: write data cached in memory to the disk";
+    static constexpr std::string_view output = "disk flushed";
+    static constexpr std::string_view cmd = "fl";
+
+    void operator()(fs::Filesystem& fs) const
+    {
+        fs.flush();
+    }
+};
+
+struct mo
+{
+    static constexpr std::string_view usage = "mo <option> <value>";
+    static constexpr std::string_view description = "set mount option used by following in and im: scheduler fifo|scan|clook orders batched disk requests, cache lru|clock|arc replaces pages, cache_size is budget in bytes of page and directory caches, write through|back sends written data to disk at once or on close, fl and sv";
+    static constexpr std::string_view output = "{} set to {}";
+    static constexpr std::string_view cmd = "mo";
+
+    struct Input
+    {
+        std::string option;
+        std::string value;
+
+        static constexpr auto args = std::tuple{
+            &Input::option,
+            &Input::value
+        };
+    };
+
+    auto operator()(const Input in, MountOptions& options) const
+    {
+        if (in.option == "scheduler") {
+            options.scheduler = parse_value<fs::io::Scheduler::Policy>(in, {
+                {"fifo", fs::io::Scheduler::Policy::fifo},
+                {"scan", fs::io::Scheduler::Policy::scan},
+                {"clook", fs::io::Scheduler::Policy::clook}
+            });
+        } else if (in.option == "cache") {
+            options.cache = parse_value<fs::core::PageCache::Policy>(in, {
+                {"lru", fs::core::PageCache::Policy::lru},
+                {"clock", fs::core::PageCache::Policy::clock},
+                {"arc", fs::core::PageCache::Policy::arc}
+            });
+        } else if (in.option == "cache_size") {
+            if (!detail::parse(in.value, options.cache_size)) {
+                throw fs::Error{"invalid value {} of mount option {}", in.value, in.option};
+            }
+        } else if (in.option == "write") {
+            options.write = parse_value<fs::core::WritePolicy>(in, {
+                {"through", fs::core::WritePolicy::write_through},
+                {"back", fs::core::WritePolicy::write_back}
+            });
+        } else {
+            throw fs::Error{"unknown mount option {}", in.option};
+        }
+        return std::tuple{in.option, in.value};
+    }
+
+private:
+    template<typename T>
+    static auto parse_value(const Input& in, std::initializer_list<std::pair<std::string_view, T>> values) -> T
+    {
+        for (const auto& [name, value] : values) {
+            if (in.value == name) {
+                return value;
+            }
+        }
+        throw fs::Error{"invalid value {} of mount option {}", in.value, in.option};
+    }
+};
+
 struct in
 {
     static constexpr std::string_view usage = "in <cylinders> <tracks> <sectors> <block_size> <path>";
@@ -277,21 +527,46 @@ struct in
         };
     };
 
-    auto operator()(const Input in, std::optional<fs::Filesystem>& fs) const
+    auto operator()(const Input in, std::optional<fs::Filesystem>& fs, const MountOptions& options) const
     {
-        auto io = fs::IO::load(in.path);
+        return mount(in, fs, options, fs::IO::Backend::memory);
+    }
+
+protected:
+    static auto mount(const Input& in, std::optional<fs::Filesystem>& fs, const MountOptions& options,
+                      const fs::IO::Backend backend) -> std::tuple<std::string>
+    {
+        const auto geometry = fs::io::Geometry{.cylinders = in.cylinders, .tracks = in.tracks, .sectors = in.sectors};
+        auto io = fs::IO::load(in.path, backend);
         std::string result{"restored"};
         if (!io) {
-            io = fs::IO{in.cylinders, in.tracks, in.sectors, in.block_size};
+            io = backend == fs::IO::Backend::mapped
+                    ? fs::IO::map(in.path, geometry.blocks_number(), in.block_size)
+                    : fs::IO{geometry, in.block_size};
             result = "initialized";
         }
+        if (io->blocks_number() == geometry.blocks_number()) { // images do not store geometry, apply the given one if it fits
+            io->set_geometry(geometry);
+        }
+        io->set_scheduler(fs::io::Scheduler::make(options.scheduler));
 
-        auto cached = std::make_unique<fs::core::Cached>(std::make_unique<fs::IO>(std::move(*io)));
-        fs.emplace(std::move(cached));
+        fs.emplace(fs::core::make_cached(std::make_unique<fs::IO>(std::move(*io)), options.cache_size, options.cache, options.write)); // core specialized for block size, if possible
         return std::tuple{std::move(result)};
     }
 };
 
+struct im : in
+{
+    static constexpr std::string_view usage = "im <cylinders> <tracks> <sectors> <block_size> <path>";
+    static constexpr std::string_view description = "same as in, but the disk is memory-mapped onto the file, so mounting is instant and saving to the same file only flushes changed pages";
+    static constexpr std::string_view cmd = "im";
+
+    auto operator()(const Input in, std::optional<fs::Filesystem>& fs, const MountOptions& options) const
+    {
+        return mount(in, fs, options, fs::IO::Backend::mapped);
+    }
+};
+
 struct sv
 {
     static constexpr std::string_view usage = "sv <path>";
@@ -315,14 +590,89 @@ struct sv
     }
 };
 
-using Commands = std::tuple<cr, de, op, cl, rd, wr, sk, dr, in, sv>;
+struct sz
+{
+    static constexpr std::string_view usage = "sz <path>";
+    static constexpr std::string_view description = "close all files and save the contents of the disk in the file <path> in compact format";
+    static constexpr std::string_view output = "disk saved";
+    static constexpr std::string_view cmd = "sz";
+
+    struct Input
+    {
+        std::string path;
+
+        static constexpr auto args = std::tuple{
+            &Input::path
+        };
+    };
+
+    void operator()(const Input in, std::optional<fs::Filesystem>& fs) const
+    {
+        fs->save(in.path, fs::IO::Format::compact);
+        fs.reset();
+    }
+};
+
+struct st
+{
+    static constexpr std::string_view usage = "st";
+    static constexpr std::string_view description = "statistics: show disk accesses, seeks, simulated time and page cache hits since mount or the previous st, then reset them";
+    static constexpr std::string_view output = "{} accesses, {} seeks, {} cylinders travelled, {:.3f} ms{}";
+    static constexpr std::string_view cmd = "st";
+
+    auto operator()(fs::Filesystem& fs) const
+    {
+        const auto io = fs.io_stats();
+        const auto cache = fs.cache_stats();
+        fs.reset_stats();
+        const auto cache_line = cache
+            ? fmt::format("; page cache: {} hits, {} misses, {} evictions", cache->hits, cache->misses, cache->evictions)
+            : std::string{};
+        return std::tuple{io.accesses, io.seeks, io.cylinders_travelled, io.elapsed_ms, cache_line};
+    }
+};
+
+struct bk
+{
+    static constexpr std::string_view usage = "bk <path> <block>";
+    static constexpr std::string_view description = "display block <block> of the disk image <path> in hex, reading only that block even from a compact image, without mounting it";
+    static constexpr std::string_view output = "{} bytes: {}";
+    static constexpr std::string_view cmd = "bk";
+
+    struct Input
+    {
+        std::string path;
+        size_t block;
+
+        static constexpr auto args = std::tuple{
+            &Input::path,
+            &Input::block
+        };
+    };
+
+    auto operator()(const Input in) const
+    {
+        std::vector<std::byte> data(max_block_length);
+        data.resize(fs::IO::read_image_block(in.path, in.block, data));
+        std::string result;
+        for (const auto byte : data) {
+            result += fmt::format("{:02x}", std::to_integer<unsigned>(byte));
+        }
+        return std::tuple{data.size(), result};
+    }
+
+private:
+    static constexpr size_t max_block_length = 1u << 16;
+};
+
+using Commands = std::tuple<cr, de, op, cl, rd, wr, pr, pw, sk, dr, ls, mkdir, rmdir, cd, fl, st, mo, in, im, sv, sz, bk>;
 
 template<typename F, typename... Args>
 void error(F&& format, Args&&... args)
 {
     fmt::print(fmt::emphasis::bold | fg(fmt::color::red), "error");
     fmt::print(": ");
-    fmt::print(std::forward<F>(format), std::forward<Args>(args)...);
+    fmt::vprint(std::forward<F>(format), fmt::make_format_args(args...));
 }
 
 template<typename Cmd, typename... Args>
@@ -366,6 +716,7 @@ int main()
 
     /// Create dummy filesystem
     std::optional<fs::Filesystem> fs;
+    MountOptions options;
 
     /// Run main loop
     for (;;) {
@@ -402,14 +753,18 @@ int main()
                         return error("invalid arguments");
                     }
 
-                    if constexpr (std::is_same_v<cmd, in>) {
-                        process<cmd>(input, fs);
+                    if constexpr (std::is_same_v<cmd, in> || std::is_same_v<cmd, im>) {
+                        process<cmd>(input, fs, options);
+                    } else if constexpr (std::is_same_v<cmd, mo>) {
+                        process<cmd>(input, options);
+                    } else if constexpr (std::is_same_v<cmd, bk>) {
+                        process<cmd>(input);
                     } else {
                         if (!fs) {
                             return error("filesystem should be initialized");
                         }
 
-                        if constexpr (std::is_same_v<cmd, sv>) {
+                        if constexpr (std::is_same_v<cmd, sv> || std::is_same_v<cmd, sz>) {
                             process<cmd>(input, fs);
                         } else {
                             process<cmd>(input, *fs);
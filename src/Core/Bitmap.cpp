@@ -0,0 +1,117 @@
+#include <Core/Bitmap.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+
+namespace fs::core {
+namespace {
+
+/**
+ * @brief Mask with bits [first, last) of a word set, counting from the most significant bit.
+ */
+constexpr auto range_mask(std::size_t first, std::size_t last) noexcept -> std::uint64_t {
+    const auto head = first == 0u ? ~std::uint64_t{0} : ~std::uint64_t{0} >> first;
+    const auto tail = last >= 64u ? ~std::uint64_t{0} : ~(~std::uint64_t{0} >> last);
+    return head & tail;
+}
+
+} // namespace
+
+template <class Byte>
+BasicBitmap<Byte>::BasicBitmap(std::span<Byte> bytes) noexcept
+    : _bytes{bytes}
+{}
+
+template <class Byte>
+auto BasicBitmap<Byte>::size() const noexcept -> std::size_t {
+    return _bytes.size() * CHAR_BIT;
+}
+
+template <class Byte>
+auto BasicBitmap<Byte>::test(std::size_t index) const noexcept -> bool {
+    return static_cast<bool>((_bytes[index / CHAR_BIT] >> (CHAR_BIT - 1 - index % CHAR_BIT)) & std::byte{1});
+}
+
+template <class Byte>
+void BasicBitmap<Byte>::set(std::size_t index, bool value) noexcept
+    requires (!std::is_const_v<Byte>)
+{
+    const auto bitmask = std::byte{1} << (CHAR_BIT - 1 - index % CHAR_BIT);
+    if (value) {
+        _bytes[index / CHAR_BIT] |= bitmask;
+    } else {
+        _bytes[index / CHAR_BIT] &= ~bitmask;
+    }
+}
+
+template <class Byte>
+auto BasicBitmap<Byte>::load(std::size_t word, std::size_t first, std::size_t last, bool outside) const noexcept -> std::uint64_t {
+    const auto byte_first = word * sizeof(std::uint64_t);
+    std::uint64_t value = 0u;
+    if (byte_first + sizeof(std::uint64_t) <= _bytes.size()) { // big-endian load keeps bit order of bytes
+        for (std::size_t i = 0u; i < sizeof(std::uint64_t); ++i) {
+            value = (value << CHAR_BIT) | static_cast<std::uint64_t>(_bytes[byte_first + i]);
+        }
+    } else {
+        for (std::size_t i = 0u; i < sizeof(std::uint64_t); ++i) {
+            const auto byte = byte_first + i < _bytes.size() ? _bytes[byte_first + i] : std::byte{0};
+            value = (value << CHAR_BIT) | static_cast<std::uint64_t>(byte);
+        }
+    }
+
+    const auto word_first = word * kWordBits;
+    const auto mask = range_mask(first > word_first ? first - word_first : 0u,
+                                 std::min(last - word_first, kWordBits));
+    return outside ? value | ~mask : value & mask;
+}
+
+template <class Byte>
+auto BasicBitmap<Byte>::count_zeros(std::size_t first, std::size_t last) const noexcept -> std::size_t {
+    last = std::min(last, size());
+    std::size_t zeros = 0u;
+    for (auto word = first / kWordBits; word * kWordBits < last; ++word) {
+        zeros += static_cast<std::size_t>(std::popcount(~load(word, first, last, true)));
+    }
+    return first < last ? zeros : 0u;
+}
+
+template <class Byte>
+auto BasicBitmap<Byte>::find_zero(std::size_t first, std::size_t last) const noexcept -> std::optional<std::size_t> {
+    last = std::min(last, size());
+    for (auto word = first / kWordBits; first < last && word * kWordBits < last; ++word) {
+        if (const auto value = load(word, first, last, true); value != ~std::uint64_t{0}) {
+            return word * kWordBits + static_cast<std::size_t>(std::countl_one(value));
+        }
+    }
+    return std::nullopt;
+}
+
+template <class Byte>
+auto BasicBitmap<Byte>::find_one(std::size_t first, std::size_t last) const noexcept -> std::optional<std::size_t> {
+    last = std::min(last, size());
+    for (auto word = first / kWordBits; first < last && word * kWordBits < last; ++word) {
+        if (const auto value = load(word, first, last, false); value != 0u) {
+            return word * kWordBits + static_cast<std::size_t>(std::countl_zero(value));
+        }
+    }
+    return std::nullopt;
+}
+
+template <class Byte>
+auto BasicBitmap<Byte>::find_zero_run(std::size_t count, std::size_t first, std::size_t last) const noexcept -> std::optional<std::size_t> {
+    last = std::min(last, size());
+    while (const auto start = find_zero(first, last)) {
+        const auto end = find_one(*start, std::min(last, *start + count)).value_or(std::min(last, *start + count));
+        if (end - *start >= count) {
+            return start;
+        }
+        first = end;
+    }
+    return std::nullopt;
+}
+
+template class BasicBitmap<std::byte>;
+template class BasicBitmap<const std::byte>;
+
+} // namespace fs::core
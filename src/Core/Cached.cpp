@@ -1,111 +1,631 @@
 #include <Core/Cached.hpp>
 
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
 namespace fs::core {
+namespace {
+
+/**
+ * @brief Most pages read ahead of a sequential stream at once.
+ */
+constexpr std::size_t max_read_ahead_pages = 64u;
+
+/**
+ * @brief Most sequential streams tracked in one file, e.g. handles reading it in turns.
+ */
+constexpr std::size_t max_streams_per_file = 4u;
+
+/**
+ * @brief Bytes counted against directory budget for one cached name, be it listing entry or dentry,
+ *        with its reverse mapping used to keep listing up to date.
+ */
+auto name_charge(std::string_view name) noexcept -> std::ptrdiff_t {
+    return static_cast<std::ptrdiff_t>(sizeof(Directory::Entry) + sizeof(std::pair<Directory::index_type, std::string>) + 2 * name.size());
+}
+
+/**
+ * @brief Cached listing ready to be changed in place, copied first if a snapshot of it is still in use.
+ *        Snapshots are only taken under the dentry lock, so a listing held by cache alone cannot be shared meanwhile.
+ */
+auto writable(std::shared_ptr<Directory>& listing) -> Directory& {
+    if (listing.use_count() > 1) {
+        listing = std::make_shared<Directory>(*listing);
+    }
+    return *listing;
+}
+
+} // namespace
+
+template <std::size_t BlockLength>
+BasicCached<BlockLength>::BasicCached(std::unique_ptr<IO> io) :
+    BasicCached{std::move(io), default_cache_length, PageCache::Policy::arc}
+{}
 
-Cached::Cached(std::unique_ptr<IO> io) :
-    Default{std::move(io)}
+template <std::size_t BlockLength>
+BasicCached<BlockLength>::BasicCached(std::unique_ptr<IO> io, std::size_t cache_length, PageCache::Policy policy,
+                                      WritePolicy write_policy) :
+    Base{std::move(io)},
+    _directory_capacity{cache_length / directory_cache_share},
+    _pages{(cache_length - _directory_capacity) / this->block_length(), policy},
+    _write_policy{write_policy}
 {}
 
-void Cached::close(Directory::Entry::index_type index)
+template <std::size_t BlockLength>
+BasicCached<BlockLength>::~BasicCached()
 {
-    _buffers.erase(index);
-    Default::close(index);
+    try {
+        const std::lock_guard lock{_cache_mutex};
+        while (!_dirty.empty()) {
+            write_back(_dirty.begin()->first);
+        }
+    } catch (const Error&) {    // destructor must not throw, data that does not fit on disk is lost
+    }
 }
 
-auto Cached::read(Directory::Entry::index_type index, std::size_t pos, std::span<std::byte> dst) const -> std::size_t
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::close(Directory::Entry::index_type index)
 {
-    if (auto buf_it = _buffers.find(index); buf_it != _buffers.end()) {    // if exists buffer for this file
-         const Buffer& buf = buf_it->second;
-         if (pos >= buf.buf_start_pos && pos + dst.size() <= buf.buf_start_pos + buf.data.size()) {    // if needed data is buffered
-             std::copy_n(buf.data.begin() + (pos - buf.buf_start_pos), dst.size(), dst.begin());
-             return dst.size();
-         }
-     }
-     const std::size_t temp_buf_size = dst.size() + (block_length() - (pos + dst.size()) % block_length());  // dst.size + remaining bytes to the end of block
-     auto temp_buf = std::vector<std::byte>(temp_buf_size);
-     const std::size_t read_bytes = Default::read(index, pos, temp_buf);
-     const std::size_t read_requested_bytes = std::min(dst.size(), read_bytes);
-     std::copy_n(temp_buf.begin(), read_requested_bytes, dst.begin());
+    {
+        const std::lock_guard lock{_cache_mutex};
+        write_back(index);
+        _streams.erase(index);
+    }
+    Base::close(index);    // pages stay cached for the next open
+}
 
-     auto& buf = _buffers[index];
-     buf = Buffer{.buf_start_pos = pos, .data = std::move(temp_buf)};
-     buf.data.resize(read_bytes);
-     return read_requested_bytes;
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::flush()
+{
+    {
+        const std::lock_guard lock{_cache_mutex};
+        while (!_dirty.empty()) {
+            write_back(_dirty.begin()->first);
+        }
+    }
+    Base::flush();
 }
 
-auto Cached::write(Directory::Entry::index_type index, std::size_t pos, std::span<const std::byte> src) -> std::size_t
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::save(std::string_view path, IO::Format format)
 {
-    const std::size_t bytes_written = Default::write(index, pos, src);
-    if (auto cached_file = _entry_info_cache.find(index); cached_file != _entry_info_cache.end()) {
-        auto& entries = _dir_cache[cached_file->second.first].entries;
-        const auto file = std::lower_bound(entries.begin(), entries.end(), cached_file->second.second,
-                                       [&] (const auto& file, const auto& name) { return file.name < name; });
+    flush();
+    Base::save(path, format);
+}
+
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::logical_length(Directory::Entry::index_type index) const -> std::size_t
+{
+    if (auto dirty = _dirty.find(index); dirty != _dirty.end()) {
+        return std::max(dirty->second.length, this->file_length(index));
+    }
+    return this->file_length(index);
+}
+
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::cached_page(Directory::Entry::index_type index, std::size_t page) const -> const PageCache::Page*
+{
+    if (auto dirty = _dirty.find(index); dirty != _dirty.end()) {
+        if (auto pending = dirty->second.pages.find(page); pending != dirty->second.pages.end()) {
+            return &pending->second;
+        }
+    }
+    return _pages.peek({index, page});
+}
+
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::read(Directory::Entry::index_type index, std::size_t pos, std::span<std::byte> dst) const -> std::size_t
+{
+    std::unique_lock lock{_cache_mutex};
+    auto [stream, sequential] = take_stream(index, pos);    // kept aside while disk is read, so other reads cannot move it
+
+    const auto length = logical_length(index);
+    if (pos >= length) {
+        put_stream(index, stream);
+        return 0;
+    }
+    dst = dst.first(std::min(dst.size(), length - pos));
+
+    const auto page_length = this->block_length();
+    const auto last_needed = (pos + dst.size() + page_length - 1) / page_length;
+    const auto last_in_file = (length + page_length - 1) / page_length;
+    std::size_t done = 0;
+    while (done < dst.size()) {
+        const auto page = (pos + done) / page_length;
+        const auto byte = (pos + done) % page_length;
+        const auto wanted = std::min(dst.size() - done, page_length - byte);
+        const PageCache::Page* cached = nullptr;
+        if (const auto dirty = _dirty.find(index); dirty != _dirty.end()) {    // pending data is the latest one
+            if (auto pending = dirty->second.pages.find(page); pending != dirty->second.pages.end()) {
+                cached = &pending->second;
+            }
+        }
+        if (cached == nullptr) {
+            cached = _pages.find({index, page});
+        }
+        if (cached != nullptr && byte + wanted <= cached->length) {    // page hit
+            std::copy_n(cached->data.begin() + byte, wanted, dst.begin() + done);
+            done += wanted;
+            continue;
+        }
+
+        if (sequential) {    // every miss of a stream doubles the window, so long streams need few requests
+            stream.window = std::min({std::max<std::size_t>(stream.window * 2, 1), max_read_ahead_pages, _pages.capacity() / 2});
+        }
+        const auto last_wanted = std::min(last_needed + stream.window, last_in_file);
+        auto last = page + 1;    // missing pages up to the next cached one are fetched in one batch
+        for (; last < last_wanted && cached_page(index, last) == nullptr; ++last) {}
+        auto fetched = std::vector<std::byte>((last - page) * page_length);
+        lock.unlock();    // other files are served from cache while this one waits for disk
+        static_cast<void>(Base::read(index, page * page_length, fetched));    // bytes past the end of file on disk stay zero, pending writes left a gap there
+        lock.lock();
+        const auto available = std::min(fetched.size(), length - page * page_length);
+        for (auto n = page; n < last && (n - page) * page_length < available; ++n) {
+            const auto first = fetched.begin() + (n - page) * page_length;
+            _pages.insert({index, n}, PageCache::Page{
+                    .data = {first, first + page_length},
+                    .length = std::min(page_length, available - (n - page) * page_length)});    // pages are clean, evicted ones are dropped
+        }
+
+        const auto copied = std::min(dst.size() - done, available - byte);
+        std::copy_n(fetched.begin() + byte, copied, dst.begin() + done);
+        done += copied;
+    }
+    stream.next_pos = pos + done;
+    put_stream(index, stream);
+    return done;
+}
+
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::take_stream(Directory::Entry::index_type index, std::size_t pos) const -> std::pair<Stream, bool>
+{
+    auto& streams = _streams[index];
+    const auto continued = std::find_if(streams.begin(), streams.end(), [pos](const Stream& stream) { return stream.next_pos == pos; });
+    if (continued == streams.end()) {    // random access does not read ahead, reading from the start begins a stream
+        return {Stream{.next_pos = pos, .window = 0}, pos == 0};
+    }
+    const auto stream = *continued;
+    streams.erase(continued);
+    return {stream, true};
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::put_stream(Directory::Entry::index_type index, const Stream& stream) const
+{
+    auto& streams = _streams[index];
+    streams.insert(streams.begin(), stream);
+    if (streams.size() > max_streams_per_file) {
+        streams.pop_back();
+    }
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::extend_last_page(Directory::Entry::index_type index, std::size_t old_length, std::size_t new_length)
+{
+    const auto page_length = this->block_length();
+    if (new_length <= old_length || old_length % page_length == 0) {    // there is no partially filled page
+        return;
+    }
+
+    const auto page = old_length / page_length;
+    const auto length = std::min(page_length, new_length - page * page_length);
+    const auto extend = [length](PageCache::Page& cached) {
+        if (cached.length < length) {    // file grew, the rest of its last page reads as zeros
+            std::fill(cached.data.begin() + cached.length, cached.data.begin() + length, std::byte{0});
+            cached.length = length;
+        }
+    };
+    if (auto dirty = _dirty.find(index); dirty != _dirty.end()) {
+        if (auto pending = dirty->second.pages.find(page); pending != dirty->second.pages.end()) {
+            extend(pending->second);
+        }
+    }
+    if (auto* cached = _pages.peek({index, page}); cached != nullptr) {
+        extend(*cached);
+    }
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::update_pages(Directory::Entry::index_type index, std::size_t pos, std::span<const std::byte> bytes)
+{
+    const auto page_length = this->block_length();
+    for (std::size_t done = 0; done < bytes.size();) {
+        const auto page = (pos + done) / page_length;
+        const auto byte = (pos + done) % page_length;
+        const auto count = std::min(bytes.size() - done, page_length - byte);
+        if (auto* cached = _pages.peek({index, page}); cached != nullptr) {
+            if (cached->length < byte) {    // gap left by seeking past the end of file reads as zeros
+                std::fill(cached->data.begin() + cached->length, cached->data.begin() + byte, std::byte{0});
+            }
+            std::copy_n(bytes.begin() + done, count, cached->data.begin() + byte);
+            cached->length = std::max(cached->length, byte + count);
+        }
+        done += count;
+    }
+}
+
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::write_pending(Directory::Entry::index_type index, std::size_t pos, std::span<const std::byte> src) -> std::size_t
+{
+    const auto page_length = this->block_length();
+    const auto max_length = Descriptor::max_blocks(page_length) * page_length;
+    if (pos >= max_length) {
+        return 0;
+    }
+    src = src.first(std::min(src.size(), max_length - pos));
+
+    const auto old_length = logical_length(index);
+    extend_last_page(index, old_length, std::max(old_length, pos + src.size()));
+    auto& file = _dirty.try_emplace(index, DirtyFile{.pages = {}, .length = old_length}).first->second;
+    for (std::size_t done = 0; done < src.size();) {
+        const auto page = (pos + done) / page_length;
+        const auto byte = (pos + done) % page_length;
+        const auto count = std::min(src.size() - done, page_length - byte);
+        auto [pending, inserted] = file.pages.try_emplace(page);
+        if (inserted) {    // page gets its current content, unless it is overwritten entirely
+            ++_dirty_pages;
+            const auto existing = old_length > page * page_length ? std::min(page_length, old_length - page * page_length) : 0u;
+            pending->second.data.resize(page_length);
+            pending->second.length = existing;
+            if (const auto* clean = _pages.peek({index, page}); clean != nullptr) {
+                std::copy_n(clean->data.begin(), std::min(clean->length, existing), pending->second.data.begin());
+            } else if (existing != 0 && (byte != 0 || count < existing)) {
+                static_cast<void>(Base::read(index, page * page_length, std::span{pending->second.data}.first(existing)));
+            }
+        }
+        std::copy_n(src.begin() + done, count, pending->second.data.begin() + byte);
+        pending->second.length = std::max(pending->second.length, byte + count);
+        done += count;
+    }
+    file.length = std::max(old_length, pos + src.size());
+
+    if (_dirty_pages > std::max<std::size_t>(_pages.capacity() / 2, 1)) {    // too much memory is held by pending data
+        write_back(index);    // only the caller's file, others may be in use by other threads and go on their next write
+    }
+    return src.size();
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::write_back(Directory::Entry::index_type index)
+{
+    const auto dirty = _dirty.find(index);
+    if (dirty == _dirty.end()) {
+        return;
+    }
+    auto pages = std::move(dirty->second.pages);
+    _dirty_pages -= pages.size();
+    _dirty.erase(dirty);
 
-        file->size = std::max(file->size, pos + bytes_written);    // updating file size in cache
+    const auto page_length = this->block_length();
+    bool lost = false;
+    std::vector<std::byte> batch;
+    for (auto page = pages.begin(); page != pages.end();) {
+        const auto first = page;
+        batch.clear();
+        do {    // adjacent full pages go in one request, short one can only be the last page of file
+            batch.insert(batch.end(), page->second.data.begin(), page->second.data.begin() + page->second.length);
+            ++page;
+        } while (page != pages.end() && page->first == std::prev(page)->first + 1 && std::prev(page)->second.length == page_length);
+
+        if (Base::write(index, first->first * page_length, batch) < batch.size()) {
+            lost = true;
+            continue;
+        }
+        for (auto clean = first; clean != page; ++clean) {
+            _pages.insert({index, clean->first}, std::move(clean->second));
+        }
+    }
+
+    if (lost) {
+        _pages.erase_file(index);    // cached pages may hold data that did not get to disk
+        throw Error{"not enough space on disk to write back file {}", index};
+    }
+}
+
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::write(Directory::Entry::index_type index, std::size_t pos, std::span<const std::byte> src) -> std::size_t
+{
+    std::size_t bytes_written = 0;
+    if (_write_policy == WritePolicy::write_back) {
+        const std::lock_guard lock{_cache_mutex};
+        bytes_written = write_pending(index, pos, src);
+    } else {
+        const auto old_length = this->file_length(index);
+        bytes_written = Base::write(index, pos, src);
+        const std::lock_guard lock{_cache_mutex};
+        extend_last_page(index, old_length, this->file_length(index));
+        update_pages(index, pos, src.first(bytes_written));
+    }
+
+    const auto length = [this, index] {
+        const std::lock_guard lock{_cache_mutex};
+        return logical_length(index);
+    }();
+    const std::lock_guard lock{_dentry_mutex};
+    if (auto cached_file = _entry_info_cache.find(index); cached_file != _entry_info_cache.end()) {
+        const auto cached_dir = _directories.find(cached_file->second.first);
+        if (cached_dir == _directories.end() || cached_dir->second.listing == nullptr) {
+            return bytes_written;
+        }
+        auto& listing = cached_dir->second.listing;
+        const auto by_name = [] (const auto& file, const auto& name) { return file.name < name; };
+        const auto file = std::lower_bound(listing->entries.begin(), listing->entries.end(), cached_file->second.second, by_name);
+        if (file->size != length) {    // overwriting file in place leaves shared listing alone
+            auto& entries = writable(listing).entries;
+            std::lower_bound(entries.begin(), entries.end(), cached_file->second.second, by_name)->size = length;    // updating file size in cache
+        }
     }
     return bytes_written;
 }
 
-auto Cached::create(Directory::index_type dir, const File& file) -> Directory::Entry::index_type
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::fetch_directory(Directory::index_type dir) const -> std::shared_ptr<Directory>
+{
+    auto directory = std::make_shared<Directory>(Base::list_directory(dir));
+    const std::lock_guard lock{_cache_mutex};
+    for (auto& entry : directory->entries) {
+        if (!entry.is_directory) {
+            entry.size = logical_length(entry.index);    // pending writes may have made file longer
+        }
+    }
+    return directory;
+}
+
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::touch_directory(Directory::index_type dir) const -> CachedDirectory*
+{
+    const auto cached_dir = _directories.find(dir);
+    if (cached_dir == _directories.end()) {
+        return nullptr;
+    }
+    _recent_directories.splice(_recent_directories.begin(), _recent_directories, cached_dir->second.recent);
+    return &cached_dir->second;
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::cache_listing(Directory::index_type dir, const std::shared_ptr<Directory>& listing) const
+{
+    auto charge = std::ptrdiff_t{0};
+    for (const auto& entry : listing->entries) {
+        charge += name_charge(entry.name);
+    }
+    if (static_cast<std::size_t>(charge) > _directory_capacity) {    // caching it would evict everything else
+        return;
+    }
+
+    drop_directory(dir);    // listing supersedes dentries
+    auto& cached_dir = _directories[dir];
+    cached_dir.listing = listing;
+    cached_dir.recent = _recent_directories.insert(_recent_directories.begin(), dir);
+    for (const auto& entry : listing->entries) {
+        _entry_info_cache[entry.index] = {dir, entry.name};
+    }
+    charge_directory(dir, charge);
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::cache_dentry(Directory::index_type dir, std::string_view name, Directory::Entry::index_type index) const
+{
+    auto* cached_dir = touch_directory(dir);
+    if (cached_dir == nullptr) {
+        cached_dir = &_directories[dir];
+        cached_dir->recent = _recent_directories.insert(_recent_directories.begin(), dir);
+    }
+    if (cached_dir->dentries.emplace(name, index).second) {
+        _entry_info_cache[index] = {dir, std::string{name}};
+        charge_directory(dir, name_charge(name));
+    }
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::charge_directory(Directory::index_type dir, std::ptrdiff_t bytes) const
+{
+    _directories[dir].charge += bytes;
+    _directory_bytes += bytes;
+    while (_directory_bytes > _directory_capacity && _recent_directories.back() != dir) {
+        drop_directory(_recent_directories.back());
+    }
+    if (_directory_bytes > _directory_capacity) {    // directory outgrew budget on its own
+        drop_directory(dir);
+    }
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::drop_directory(Directory::index_type dir) const
 {
-    const auto res = Default::create(dir, file);
-    if (auto cached_dir_it = _dir_cache.find(dir); cached_dir_it != _dir_cache.end()) {    // caching entry in this block
-        auto& cached_entries = cached_dir_it->second.entries;
+    const auto cached_dir = _directories.find(dir);
+    if (cached_dir == _directories.end()) {
+        return;
+    }
+    const auto forget = [this, dir](Directory::Entry::index_type index) {
+        if (auto info = _entry_info_cache.find(index); info != _entry_info_cache.end() && info->second.first == dir) {
+            _entry_info_cache.erase(info);
+        }
+    };
+    if (cached_dir->second.listing != nullptr) {
+        for (const auto& entry : cached_dir->second.listing->entries) {
+            forget(entry.index);
+        }
+    }
+    for (const auto& [name, index] : cached_dir->second.dentries) {
+        forget(index);
+    }
+    _directory_bytes -= cached_dir->second.charge;
+    _recent_directories.erase(cached_dir->second.recent);
+    _directories.erase(cached_dir);    // snapshots of listing handed out stay valid
+}
+
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::create(Directory::index_type dir, const File& file) -> Directory::Entry::index_type
+{
+    const auto res = Base::create(dir, file);
+    const std::lock_guard lock{_dentry_mutex};
+    if (auto* cached_dir = touch_directory(dir); cached_dir != nullptr && cached_dir->listing != nullptr) {    // caching entry in this block
+        auto& cached_entries = writable(cached_dir->listing).entries;
         auto inserted = cached_entries.insert(
                 std::upper_bound(cached_entries.begin(), cached_entries.end(), file,
                                  [&](const auto &lhs, const auto &rhs) { return lhs.name < rhs.name; }),
                 Directory::Entry{file, res}
         );
         _entry_info_cache[inserted->index] = {dir, file.name};
-    } else {    // adding cache for this dir
-        if (auto fetched_dir = Default::get(dir); fetched_dir.has_value()) {
-            const auto& cached_dir = _dir_cache[dir] = std::move(*fetched_dir);
-            for (const auto& cached_entry : cached_dir.entries) {
-                _entry_info_cache[cached_entry.index] = {dir, cached_entry.name};
-            }
-        }
+        charge_directory(dir, name_charge(file.name));
+    } else {    // new file is likely to be opened next, listing is read only when asked for
+        cache_dentry(dir, file.name, res);
     }
     return res;
 }
 
-auto Cached::search(Directory::index_type dir, std::string_view name) const -> std::optional<Directory::Entry::index_type>
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::search(Directory::index_type dir, std::string_view name) const -> std::optional<Directory::Entry::index_type>
 {
-    if (auto found_dir = _dir_cache.find(dir); found_dir != _dir_cache.end()) {
-        const auto file = std::lower_bound(found_dir->second.entries.begin(), found_dir->second.entries.end(), name,
-                                       [&] (const auto& file, const auto& name) { return file.name < name; });
-        if (file != found_dir->second.entries.end() && file->name == name) {
-            return file->index;
+    const std::lock_guard lock{_dentry_mutex};    // lookups of threads resolving paths memoize into the same maps
+    if (auto* cached_dir = touch_directory(dir); cached_dir != nullptr) {
+        if (cached_dir->listing != nullptr) {
+            const auto& entries = cached_dir->listing->entries;
+            const auto file = std::lower_bound(entries.begin(), entries.end(), name,
+                                           [&] (const auto& file, const auto& name) { return file.name < name; });
+            if (file != entries.end() && file->name == name) {
+                return file->index;
+            }
+            return std::nullopt; // listing of cached directory is complete
+        }
+        if (auto dentry = cached_dir->dentries.find(name); dentry != cached_dir->dentries.end()) {
+            return dentry->second;
         }
     }
-    return std::nullopt;
+
+    const auto found = Base::search(dir, name);
+    if (found.has_value()) {    // memoizing path component, so deep paths resolve without rescanning directories
+        cache_dentry(dir, name, *found);
+    }
+    return found;
 }
 
-void Cached::remove(Directory::index_type dir, Directory::Entry::index_type index)
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::remove(Directory::index_type dir, Directory::Entry::index_type index)
 {
-    Default::remove(dir, index);
-    _buffers.erase(index);
-    if (auto cached_dir_it = _dir_cache.find(dir); cached_dir_it != _dir_cache.end()) {   // cleanup cache in this block
-        auto& cached_entries = cached_dir_it->second.entries;
-        cached_entries.erase(std::find_if(cached_entries.begin(), cached_entries.end(),
-                                          [&](const auto &file) { return file.index == index; }));
-        _entry_info_cache.erase(index);
+    Base::remove(dir, index);
+    {
+        const std::lock_guard lock{_cache_mutex};
+        if (auto dirty = _dirty.find(index); dirty != _dirty.end()) {    // pending data of removed file is dropped
+            _dirty_pages -= dirty->second.pages.size();
+            _dirty.erase(dirty);
+        }
+        _pages.erase_file(index);    // index is reused by the next file created
+        _streams.erase(index);
     }
+    const std::lock_guard lock{_dentry_mutex};
+    drop_directory(index);    // removed file might be an empty directory
+    const auto info = _entry_info_cache.find(index);
+    if (info == _entry_info_cache.end()) {    // nothing is cached about removed file
+        return;
+    }
+    if (auto cached_dir = _directories.find(dir); cached_dir != _directories.end()) {
+        if (cached_dir->second.listing != nullptr) {    // cleanup cache in this block
+            auto& cached_entries = writable(cached_dir->second.listing).entries;
+            cached_entries.erase(std::find_if(cached_entries.begin(), cached_entries.end(),
+                                              [&](const auto &file) { return file.index == index; }));
+        } else {
+            cached_dir->second.dentries.erase(info->second.second);
+        }
+        charge_directory(dir, -name_charge(info->second.second));
+    }
+    _entry_info_cache.erase(info);
 }
 
-auto Cached::get(Directory::index_type dir) const -> std::optional<Directory>
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::get(Directory::index_type dir) const -> std::shared_ptr<const Directory>
 {
-    if (auto cached_dir_it = _dir_cache.find(dir); cached_dir_it != _dir_cache.end()) {     // if dir is present in cache
-        return cached_dir_it->second;
+    const std::lock_guard lock{_dentry_mutex};
+    if (auto* cached_dir = touch_directory(dir); cached_dir != nullptr && cached_dir->listing != nullptr) {     // if dir is present in cache
+        return cached_dir->listing;    // shared, not copied
     }
     else {    // adding cache for this dir entries
-        std::optional directory = Default::get(dir);
-        if (directory.has_value()) {
-             const auto& cached_dir = _dir_cache[dir] = *directory;
-             for (const auto& cached_entry : cached_dir.entries) {
-                 _entry_info_cache[cached_entry.index] = {dir, cached_entry.name};
+        auto listing = fetch_directory(dir);
+        cache_listing(dir, listing);
+        return listing;
+    }
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::for_each_entry(Directory::index_type dir, std::string_view prefix,
+                                               const Interface::EntryVisitor& visitor) const
+{
+    const auto listing = [this, dir] {
+        const std::lock_guard lock{_dentry_mutex};
+        const auto* cached_dir = touch_directory(dir);
+        return cached_dir != nullptr ? std::shared_ptr<const Directory>{cached_dir->listing} : nullptr;
+    }();
+    if (listing != nullptr) {    // snapshot is walked without lock, matching names are adjacent in sorted listing
+        const auto& entries = listing->entries;
+        for (auto file = std::lower_bound(entries.begin(), entries.end(), prefix,
+                                          [] (const auto& file, const auto& prefix) { return file.name < prefix; });
+             file != entries.end() && file->name.starts_with(prefix); ++file)
+        {
+            if (!visitor(*file)) {
+                return;
+            }
+        }
+        return;
+    }
+
+    Base::for_each_entry(dir, prefix, [this, &visitor](const Directory::Entry& entry) {
+        auto patched = std::optional<Directory::Entry>{};
+        if (!entry.is_directory) {
+            const std::lock_guard lock{_cache_mutex};
+            if (_dirty.contains(entry.index)) {
+                patched = entry;
+                patched->size = logical_length(entry.index);    // pending writes may have made file longer
             }
         }
-        return directory;
+        return visitor(patched.has_value() ? *patched : entry);
+    });
+}
+
+template <std::size_t BlockLength>
+auto BasicCached<BlockLength>::cache_stats() const -> std::optional<PageCache::Stats>
+{
+    const std::lock_guard lock{_cache_mutex};
+    return _pages.stats();
+}
+
+template <std::size_t BlockLength>
+void BasicCached<BlockLength>::reset_stats()
+{
+    Base::reset_stats();
+    const std::lock_guard lock{_cache_mutex};
+    _pages.reset_stats();
+}
+
+template class BasicCached<dynamic_block_length>;
+template class BasicCached<64u>;
+template class BasicCached<128u>;
+template class BasicCached<256u>;
+template class BasicCached<512u>;
+template class BasicCached<1024u>;
+template class BasicCached<2048u>;
+template class BasicCached<4096u>;
+
+namespace {
+
+template <std::size_t... BlockLengths>
+auto make_specialized_cached(std::unique_ptr<IO>& io, std::size_t cache_length, PageCache::Policy policy,
+                             WritePolicy write_policy, std::index_sequence<BlockLengths...>) -> Interface::Ptr {
+    Interface::Ptr core;
+    ((io->block_length() == BlockLengths
+      && (core = std::make_unique<BasicCached<BlockLengths>>(std::move(io), cache_length, policy, write_policy), true)) || ...);
+    return core;
+}
+
+} // namespace
+
+auto make_cached(std::unique_ptr<IO> io, std::size_t cache_length, PageCache::Policy policy,
+                 WritePolicy write_policy) -> Interface::Ptr {
+    if (auto core = make_specialized_cached(io, cache_length, policy, write_policy, specialized_block_lengths{})) {
+        return core;
     }
+    return std::make_unique<Cached>(std::move(io), cache_length, policy, write_policy); // block length is not specialized, fall back to runtime arithmetic
 }
+
 } // namespace fs::core
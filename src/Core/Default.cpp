@@ -1,218 +1,590 @@
 #include <Core/Default.hpp>
+#include <Core/Bitmap.hpp>
+#include <algorithm>
 #include <climits>
+#include <cstdint>
+#include <limits>
 #include <array>
 #include <numeric>
 #include <cstddef>
 #include <optional>
+#include <utility>
 
 namespace fs::core {
 namespace {
 
-constexpr std::size_t bitmap_block_number = 0u;
-constexpr std::size_t first_descriptor_block = bitmap_block_number + 1;
-constexpr std::size_t fs_init_flag_bits = 1u; // number of bits reserved for flag telling whether fs is inited
-
-void set_bit(std::span<std::byte> bitmap, std::size_t index, bool value) {
-    index += fs_init_flag_bits;
-    const auto block_num = index / CHAR_BIT;
-    const auto in_block_position = index % CHAR_BIT;
-    const auto bitmask = (std::byte{1} << (CHAR_BIT - 1 - in_block_position));
-    if (value) {
-        bitmap[block_num] |= bitmask;
-    } else {
-        bitmap[block_num] &= (bitmask ^ std::byte{0});
+constexpr std::size_t bitmap_block_number = 0u; // first bitmap block, descriptor blocks follow the last one
+constexpr std::size_t superblock_bits = Packed<Superblock>::size * CHAR_BIT; // bitmap bits taken by superblock
+constexpr std::size_t descriptor_size = Packed<Descriptor>::size;
+constexpr std::size_t entry_size = Packed<DirectoryEntry>::size;
+constexpr std::size_t max_probe_length = 16u; // every directory entry lies within this many slots from its home slot
+
+/**
+ * @brief FNV-1a hash of a file name, selects home slot of directory entry
+ */
+auto hash_name(std::string_view name) noexcept -> std::size_t {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const auto c : name) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
     }
+    return static_cast<std::size_t>(hash);
 }
 
-auto get_bit(std::span<const std::byte> bitmap, std::size_t index) -> bool {
-    index += fs_init_flag_bits;
-    const auto block_num = index / CHAR_BIT;
-    const auto in_block_position = index % CHAR_BIT;
-    const auto bitmask = std::byte{1};
-
-    return static_cast<bool>((bitmap[block_num] >> (CHAR_BIT - 1 - in_block_position)) & bitmask);
+auto entry_name(const DirectoryEntry& entry) noexcept -> std::string_view {
+    return {entry.name.data(), entry.name_length};
 }
 
-auto count_free_bits(std::span<const std::byte> bitmap, std::size_t max_bits) -> std::size_t {
-    std::size_t free_bits = 0u;
-    for (std::size_t i = 0u; i < std::min(bitmap.size() * CHAR_BIT, max_bits); ++i) {
-        if (!get_bit(bitmap, i)) {
-            ++free_bits;
-        }
-    }
-    return free_bits;
+/**
+ * @brief Slot that has never held an entry, unlike a tombstone left by removal which keeps the name
+ */
+auto is_empty_slot(const DirectoryEntry& entry) noexcept -> bool {
+    return !entry.is_occupied && entry.name_length == 0u;
 }
 
-struct UtilityStruct {
-    bool is_occupied = true;
-};
-
-struct Descriptor : UtilityStruct {
-    static constexpr std::size_t max_blocks_for_file = 3u;
-    std::size_t length = 0u;
-    std::array<std::size_t, max_blocks_for_file> blocks;
-
-    [[nodiscard]]
-    auto blocks_allocated(std::size_t block_size) const noexcept -> std::size_t {
-        return (length + block_size - 1) / block_size;
-    }
-
-    [[nodiscard]]
-    auto free_bytes(std::size_t block_size, std::size_t pos) const noexcept -> std::size_t {
-        return blocks_allocated(block_size) * block_size - pos;
-    }
-};
-
-struct DirectoryEntry : UtilityStruct {
-    static constexpr std::size_t max_filename_length = 20u;
-
-    std::array<char, max_filename_length> name;
-    std::size_t name_length;
-    std::size_t descriptor_index = 0u;
-};
+auto directory_capacity(const Descriptor& directory) noexcept -> std::size_t {
+    return directory.length / entry_size;
+}
 
 } // namespace
 
-Default::Default(std::unique_ptr<IO> io)
+template <std::size_t BlockLength>
+BasicDefault<BlockLength>::BasicDefault(std::unique_ptr<IO> io)
     : _io{std::move(io)}
+    , _bitmap_blocks(calculate_bitmap_blocks())
     , _k(calculate_k())
-    , _block_buffer(_io->block_length())
-    , _descriptor_blocks_indexes(_k-1)
+    , _descriptor_blocks_indexes(_k - _bitmap_blocks)
+    , _free_blocks(_bitmap_blocks)
 {
-    std::iota(_descriptor_blocks_indexes.begin(), _descriptor_blocks_indexes.end(), first_descriptor_block); // set indexes of descriptor blocks
-    _io->read_block(bitmap_block_number, _block_buffer); // read bitmap to check the very first bit
-    if (!get_bit(_block_buffer, -1)) { // root reinitialization is needed
-        init_root();
+    std::iota(_descriptor_blocks_indexes.begin(), _descriptor_blocks_indexes.end(), bitmap_block_number + _bitmap_blocks); // set indexes of descriptor blocks
+    const auto superblock = read_superblock();
+    if (superblock.magic != Superblock::expected_magic) {
+        const auto block = std::as_const(*_io).block(bitmap_block_number);
+        if (std::any_of(block.begin(), block.end(), [](std::byte b) { return b != std::byte{0}; })) { // disk holds data of an older layout
+            throw Error{"unsupported disk layout: superblock is missing"};
+        }
+        init_root(); // disk is not formatted, root reinitialization is needed
+    } else if (superblock.version != layout_version) {
+        throw Error{"unsupported disk layout version {}: expected version {}", superblock.version, layout_version};
     }
+    count_free_blocks();
+    load_descriptors();
 }
 
-auto Default::block_length() const noexcept -> std::size_t {
-    return _io->block_length();
+template <std::size_t BlockLength>
+BasicDefault<BlockLength>::~BasicDefault() {
+    flush_descriptors();
 }
 
-void Default::init_root() {
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::init_root() {
     if (write_value_to_disk_blocks(
-            Descriptor{},
+            Descriptor{.is_directory = true},
             _descriptor_blocks_indexes.begin(),
             _descriptor_blocks_indexes.end(),
             IOPosition{.block = 0u, .byte = 0u})
-        < sizeof(Descriptor))
+        < descriptor_size)
     {
         throw Error{"not enough disk space to initialize root directory"};
     }
 
-    std::fill(_block_buffer.begin() + 1, _block_buffer.end(), std::byte{0});
-    _block_buffer[0] = std::byte{1} << (CHAR_BIT - 1);
+    for (std::size_t i = 0u; i < _bitmap_blocks; ++i) {
+        const auto bitmap = _io->block(bitmap_block_number + i);
+        std::fill(bitmap.begin(), bitmap.end(), std::byte{0});
+    }
+    Packed<Superblock>::encode(Superblock{}, _io->block(bitmap_block_number).first<Packed<Superblock>::size>()); // set a clear bitmap behind a new superblock
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::read_superblock() const -> Superblock {
+    return Packed<Superblock>::decode(std::as_const(*_io).block(bitmap_block_number).first<Packed<Superblock>::size>());
+}
+
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::load_descriptors() {
+    const auto descriptor_area = _descriptor_blocks_indexes.size() * block_length();
+    std::vector<std::byte> bytes(descriptor_area / descriptor_size * descriptor_size);
+    read_bytes_from_disk_blocks(bytes, _descriptor_blocks_indexes.begin(), _descriptor_blocks_indexes.end(),
+                                IOPosition{.block = 0u, .byte = 0u}); // whole table in one batch
+
+    _descriptors.resize(bytes.size() / descriptor_size);
+    for (std::size_t i = 0u; i < _descriptors.size(); ++i) {
+        _descriptors[i] = Packed<Descriptor>::decode(std::span{bytes}.subspan(i * descriptor_size).first<descriptor_size>());
+    }
+    _dirty_descriptors.assign(_descriptors.size(), false);
+
+    _free_descriptors.clear();
+    for (auto index = _descriptors.size(); index-- > 0u;) { // lowest free index ends up on top
+        if (!_descriptors[index].is_occupied) {
+            _free_descriptors.push_back(index);
+        }
+    }
+}
+
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::flush_descriptors() {
+    const std::lock_guard lock{_metadata_mutex}; // descriptors of files being written are updated meanwhile
+    for (std::size_t first = 0u; first < _descriptors.size();) {
+        if (!_dirty_descriptors[first]) {
+            ++first;
+            continue;
+        }
+        auto last = first;
+        for (; last < _descriptors.size() && _dirty_descriptors[last]; ++last) {
+            _dirty_descriptors[last] = false;
+        }
+        std::vector<std::byte> bytes((last - first) * descriptor_size);
+        for (auto i = first; i < last; ++i) {
+            Packed<Descriptor>::encode(_descriptors[i], std::span{bytes}.subspan((i - first) * descriptor_size).first<descriptor_size>());
+        }
+        write_bytes_to_disk_blocks(
+                bytes,
+                _descriptor_blocks_indexes.begin(),
+                _descriptor_blocks_indexes.end(),
+                IOPosition::fromIndex(first * descriptor_size, block_length())); // adjacent descriptors are written together
+        first = last;
+    }
+}
+
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::update_descriptor(std::size_t index, const Descriptor& descriptor) {
+    const std::lock_guard lock{_metadata_mutex};
+    _descriptors[index] = descriptor;
+    _dirty_descriptors[index] = true;
+}
+
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::count_free_blocks() {
+    for (std::size_t i = 0u; i < _bitmap_blocks; ++i) {
+        const auto [first, last] = data_bits(i);
+        _free_blocks[i] = ConstBitmap{std::as_const(*_io).block(bitmap_block_number + i)}.count_zeros(first, last);
+    }
+    _free_blocks_total = std::accumulate(_free_blocks.begin(), _free_blocks.end(), std::size_t{0});
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::calculate_bitmap_blocks() const -> std::size_t {
+    if (block_length() != _io->block_length()) {
+        throw Error{"I/O system blocks are {} bytes long: core is specialized for {} bytes", _io->block_length(), block_length()};
+    }
+    if (std::size_t actual = block_length(), min = Packed<Superblock>::size; actual < min) {
+        throw Error{"I/O system blocks are too short: at least {} bytes needed, got {}", min, actual};
+    }
+    if (_io->blocks_number() > std::numeric_limits<block_pointer_type>::max()) {
+        throw Error{"I/O system has too many blocks: at most {} supported", std::numeric_limits<block_pointer_type>::max()};
+    }
 
-    _io->write_block(bitmap_block_number, _block_buffer); // set a clear bitmap with fs init bit set to true
+    const auto bits_per_block = block_length() * CHAR_BIT;
+    return (superblock_bits + _io->blocks_number() + bits_per_block - 1) / bits_per_block; // enough bits for any number of data blocks
 }
 
-auto Default::calculate_k() const -> std::size_t {
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::calculate_k() const -> std::size_t {
     const auto block_length_to_descriptor_size_ratio =
-            static_cast<double>(_io->block_length()) / static_cast<double>(sizeof(Descriptor));
+            static_cast<double>(block_length()) / static_cast<double>(descriptor_size);
     const auto disk_blocks = _io->blocks_number();
 
     if (disk_blocks <= 3) {
         throw Error{"I/O system has not enough logic blocks: at least 4 needed, got {}", disk_blocks};
     }
 
-    const std::size_t k = static_cast<std::size_t>(
-            (static_cast<double>(disk_blocks) - static_cast<double>(Descriptor::max_blocks_for_file)
+    const auto extra_bitmap_blocks = _bitmap_blocks - 1; // proportion below accounts for a single bitmap block
+    if (disk_blocks <= extra_bitmap_blocks + 3) {
+        throw Error{"I/O system has unusable parameters"};
+    }
+
+    const std::size_t k = extra_bitmap_blocks + static_cast<std::size_t>(
+            (static_cast<double>(disk_blocks - extra_bitmap_blocks) - static_cast<double>(Descriptor::direct_blocks)
                 + block_length_to_descriptor_size_ratio) /
             (1. + block_length_to_descriptor_size_ratio)
     );
 
-    if (k < 2 || _io->blocks_number() - k < 2) {
+    if (k < _bitmap_blocks + 1 || _io->blocks_number() - k < 2) {
         throw Error{"I/O system has unusable parameters"};
     }
 
     return k;
 }
 
-auto Default::data_blocks_count() const noexcept -> std::size_t {
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::data_blocks_count() const noexcept -> std::size_t {
     return _io->blocks_number() - _k;
 }
 
-auto Default::IOPosition::fromIndex(std::size_t index, std::size_t block_length) noexcept -> IOPosition {
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::data_bits(std::size_t bitmap_block) const noexcept -> std::pair<std::size_t, std::size_t> {
+    const auto bits_per_block = block_length() * CHAR_BIT;
+    const auto block_first = bitmap_block * bits_per_block;
+    const auto data_bits_end = superblock_bits + data_blocks_count();
+    return {bitmap_block == 0u ? superblock_bits : 0u,
+            data_bits_end > block_first ? std::min(bits_per_block, data_bits_end - block_first) : 0u};
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::free_blocks_count() const noexcept -> std::size_t {
+    return _free_blocks_total;
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::IOPosition::fromIndex(std::size_t index, std::size_t block_length) noexcept -> IOPosition {
     return {.block = index / block_length,
             .byte = index % block_length};
 }
 
-auto Default::allocate_blocks(std::span<std::size_t> blocks_ref, std::size_t blocks_allocated,
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::allocate_blocks(std::span<std::size_t> blocks_ref, std::size_t blocks_allocated,
                               std::size_t blocks_to_allocate, std::size_t block_length) -> std::size_t
 {
-    std::size_t current_block_index = blocks_allocated;
-    for (std::size_t i = 0u;
-         i < std::min(block_length * CHAR_BIT, data_blocks_count())
-            && current_block_index < std::min(
-                 blocks_allocated + blocks_to_allocate,
-                 blocks_ref.size());
-         ++i)
-    {
-        if (!get_bit(_block_buffer, i)) { // free block found
-            blocks_ref[current_block_index++] = _k + i;
-            set_bit(_block_buffer, i, true);
+    const auto bits_per_block = block_length * CHAR_BIT;
+    const auto wanted = std::min(blocks_to_allocate, blocks_ref.size() - blocks_allocated);
+    const std::lock_guard lock{_metadata_mutex}; // files written in parallel allocate from the same bitmap
+    auto bitmap_block = std::min(_allocation_hint / bits_per_block, _bitmap_blocks - 1); // start from the last allocation
+    auto from = _allocation_hint - bitmap_block * bits_per_block;
+
+    std::size_t allocated = 0u;
+    for (std::size_t visited = 0u; allocated < wanted && visited < _bitmap_blocks; ++visited) {
+        if (_free_blocks[bitmap_block] != 0u) { // summary allows to skip full bitmap blocks without reading them
+            auto bitmap = Bitmap{_io->block(bitmap_block_number + bitmap_block)}; // bitmap is patched in place
+            const auto [first, last] = data_bits(bitmap_block);
+            from = std::clamp(from, first, last);
+
+            auto bit = bitmap.find_zero_run(std::min(wanted - allocated, _free_blocks[bitmap_block]), from, last)
+                    .value_or(from); // prefer a contiguous run
+            while (allocated < wanted && _free_blocks[bitmap_block] != 0u) {
+                auto free_bit = bitmap.find_zero(bit, last);
+                if (!free_bit) {
+                    free_bit = bitmap.find_zero(first, bit); // wrap around to the beginning of the bitmap block
+                }
+                bitmap.set(*free_bit, true);
+                --_free_blocks[bitmap_block];
+                --_free_blocks_total;
+
+                const auto global_bit = bitmap_block * bits_per_block + *free_bit;
+                blocks_ref[blocks_allocated + allocated++] = _k + global_bit - superblock_bits;
+                bit = *free_bit + 1;
+                _allocation_hint = global_bit + 1;
+            }
         }
+        bitmap_block = (bitmap_block + 1) % _bitmap_blocks;
+        from = 0u;
     }
-    return current_block_index - blocks_allocated;
+    return allocated;
 }
 
-auto Default::create(Directory::index_type dir, const File &file) -> Directory::Entry::index_type {
-    if (std::size_t actual = file.name.size(), max = DirectoryEntry::max_filename_length; actual > max) {
-        throw Error{"filename is too long: maximal length is {} symbols, but given is {} symbols", max, actual};
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::free_block(std::size_t block) {
+    const auto bits_per_block = block_length() * CHAR_BIT;
+    const auto bit = block - _k + superblock_bits;
+    const auto bitmap_block = bit / bits_per_block;
+    const std::lock_guard lock{_metadata_mutex};
+    Bitmap{_io->block(bitmap_block_number + bitmap_block)}.set(bit % bits_per_block, false); // bitmap is patched in place
+    ++_free_blocks[bitmap_block];
+    ++_free_blocks_total;
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::allocate_index_block() -> std::size_t {
+    std::size_t block = 0u;
+    if (allocate_blocks(std::span{&block, 1u}, 0u, 1u, block_length()) == 0u) {
+        return 0u;
     }
-    const auto free_descriptor_pos = find_value_on_disk_blocks_if<Descriptor>(
-            _descriptor_blocks_indexes.begin(), _descriptor_blocks_indexes.end(),
-            [](const auto& descriptor) {
-                return !descriptor.is_occupied;
-            }); // find a free descriptor
-    if (!free_descriptor_pos) {
-        throw Error{"not enough space to create file"};
+    const auto pointers = _io->block(block); // block may keep data of a removed file
+    std::fill(pointers.begin(), pointers.end(), std::byte{0});
+    return block;
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::read_pointer(std::size_t block, std::size_t index) const -> std::size_t {
+    return layout::load<block_pointer_type>(std::as_const(*_io).block(block), index * sizeof(block_pointer_type));
+}
+
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::write_pointer(std::size_t block, std::size_t index, std::size_t pointer) {
+    layout::store(_io->block(block), index * sizeof(block_pointer_type), static_cast<block_pointer_type>(pointer)); // pointers are patched in place
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::file_block(const Descriptor& descriptor, std::size_t n) const -> std::size_t {
+    if (n < Descriptor::direct_blocks) {
+        return descriptor.blocks[n];
+    }
+    n -= Descriptor::direct_blocks;
+
+    const auto pointers = Descriptor::pointers_per_block(block_length());
+    if (n < pointers) {
+        return read_pointer(descriptor.indirect, n);
+    }
+    n -= pointers;
+    return read_pointer(read_pointer(descriptor.double_indirect, n / pointers), n % pointers);
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::set_file_block(Descriptor& descriptor, std::size_t n, std::size_t block) -> bool {
+    if (n < Descriptor::direct_blocks) {
+        descriptor.blocks[n] = block;
+        return true;
+    }
+    n -= Descriptor::direct_blocks;
+
+    const auto pointers = Descriptor::pointers_per_block(block_length());
+    if (n < pointers) {
+        if (descriptor.indirect == 0u && (descriptor.indirect = allocate_index_block()) == 0u) {
+            return false;
+        }
+        write_pointer(descriptor.indirect, n, block);
+        return true;
+    }
+    n -= pointers;
+
+    if (descriptor.double_indirect == 0u && (descriptor.double_indirect = allocate_index_block()) == 0u) {
+        return false;
+    }
+    auto indirect = read_pointer(descriptor.double_indirect, n / pointers);
+    if (indirect == 0u) {
+        if ((indirect = allocate_index_block()) == 0u) {
+            return false;
+        }
+        write_pointer(descriptor.double_indirect, n / pointers, indirect);
+    }
+    write_pointer(indirect, n % pointers, block);
+    return true;
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::file_blocks(const Descriptor& descriptor, std::size_t first, std::size_t last) const
+    -> const std::vector<std::size_t>&
+{
+    auto& blocks = scratch().file_blocks;
+    blocks.clear();
+    for (auto n = first; n < last; ++n) {
+        blocks.push_back(file_block(descriptor, n));
+    }
+    return blocks;
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::extend_file(Descriptor& descriptor, std::size_t first, std::size_t last) -> std::size_t {
+    std::vector<std::size_t> blocks(last - first);
+    const auto allocated = allocate_blocks(blocks, 0u, blocks.size(), block_length()); // data blocks go together to stay contiguous
+
+    auto n = first;
+    for (; n < first + allocated && set_file_block(descriptor, n, blocks[n - first]); ++n) {}
+    for (auto it = blocks.begin() + (n - first); it != blocks.begin() + allocated; ++it) { // no space left for indirect blocks
+        free_block(*it);
+    }
+    return n;
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::write_inline_data(Descriptor& descriptor, std::size_t pos, std::span<const std::byte> src) -> std::size_t {
+    if (pos >= Descriptor::inline_capacity) {
+        return 0u;
+    }
+    const auto count = std::min(src.size(), Descriptor::inline_capacity - pos);
+    if (pos > descriptor.length) { // fill the gap left by seeking past the end with zeros
+        std::fill(descriptor.data.begin() + descriptor.length, descriptor.data.begin() + pos, std::byte{0});
+    }
+    std::copy_n(src.begin(), count, descriptor.data.begin() + pos);
+    descriptor.length = std::max(descriptor.length, pos + count);
+    return count;
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::spill_inline_data(Descriptor& descriptor) -> bool {
+    auto spilled = descriptor;
+    spilled.is_inline = false;
+    spilled.data = {};
+    if (spilled.length != 0u) { // inline data fits in one block, see create
+        if (extend_file(spilled, 0u, 1u) == 0u) {
+            return false;
+        }
+        write_bytes_to_disk_blocks(std::span{descriptor.data}.first(descriptor.length),
+                                   spilled.blocks.begin(), spilled.blocks.begin() + 1,
+                                   IOPosition{.block = 0u, .byte = 0u});
+    }
+    descriptor = spilled;
+    return true;
+}
+
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::free_file_blocks(const Descriptor& descriptor) {
+    for (std::size_t n = 0u; n < descriptor.blocks_allocated(block_length()); ++n) {
+        free_block(file_block(descriptor, n));
+    }
+    if (descriptor.indirect != 0u) {
+        free_block(descriptor.indirect);
+    }
+    if (descriptor.double_indirect != 0u) {
+        for (std::size_t i = 0u; i < Descriptor::pointers_per_block(block_length()); ++i) {
+            if (const auto indirect = read_pointer(descriptor.double_indirect, i); indirect != 0u) {
+                free_block(indirect);
+            }
+        }
+        free_block(descriptor.double_indirect);
+    }
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::read_entry(const Descriptor& directory, std::size_t slot) const -> DirectoryEntry {
+    const auto block_length = this->block_length();
+    const auto position = IOPosition::fromIndex(slot * entry_size, block_length);
+    const auto& blocks = file_blocks(directory, position.block,
+                                     std::min(((slot + 1) * entry_size + block_length - 1) / block_length,
+                                              directory.blocks_allocated(block_length))); // entry may span blocks
+    return read_value_from_disk_blocks<DirectoryEntry>(blocks.begin(), blocks.end(),
+                                                       IOPosition{.block = 0u, .byte = position.byte}).value();
+}
+
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::write_entry(const Descriptor& directory, std::size_t slot, const DirectoryEntry& entry) {
+    const auto block_length = this->block_length();
+    const auto position = IOPosition::fromIndex(slot * entry_size, block_length);
+    const auto& blocks = file_blocks(directory, position.block,
+                                     std::min(((slot + 1) * entry_size + block_length - 1) / block_length,
+                                              directory.blocks_allocated(block_length)));
+    write_value_to_disk_blocks(entry, blocks.begin(), blocks.end(), IOPosition{.block = 0u, .byte = position.byte});
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::find_entry(const Descriptor& directory, std::string_view name) const -> std::optional<std::size_t> {
+    const auto capacity = directory_capacity(directory);
+    if (capacity == 0u) {
+        return std::nullopt;
     }
 
-    const auto directory_position = IOPosition{.block = 0, .byte = 0};
-    auto directory_descriptor = read_value_from_disk_blocks<Descriptor>(
-            _descriptor_blocks_indexes.begin(), _descriptor_blocks_indexes.end(),
-            directory_position).value();
+    const auto home = hash_name(name) % capacity;
+    for (std::size_t probe = 0u; probe < std::min(max_probe_length, capacity); ++probe) {
+        const auto slot = (home + probe) % capacity;
+        const auto entry = read_entry(directory, slot);
+        if (is_empty_slot(entry)) { // probe sequence of the name ends here
+            return std::nullopt;
+        }
+        if (entry.is_occupied && entry_name(entry) == name) {
+            return slot;
+        }
+    }
+    return std::nullopt;
+}
 
-    const auto block_length = _io->block_length();
-    std::size_t bytes_processed = 0u;
-    auto free_entry_slot = find_value_on_disk_blocks_if<DirectoryEntry>(
-            directory_descriptor.blocks.begin(),
-            directory_descriptor.blocks.begin() + directory_descriptor.blocks_allocated(block_length),
-            [&bytes_processed, length = directory_descriptor.length](const auto& directory_entry) {
-                if (bytes_processed < length && !directory_entry.is_occupied) {
-                    return true;
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::insert_entry(std::size_t dir, Descriptor& directory, const DirectoryEntry& entry) -> std::size_t {
+    const auto name = entry_name(entry);
+    for (;;) {
+        const auto capacity = directory_capacity(directory);
+        std::optional<std::size_t> free_slot{};
+        const auto home = capacity == 0u ? 0u : hash_name(name) % capacity;
+        for (std::size_t probe = 0u; probe < std::min(max_probe_length, capacity); ++probe) {
+            const auto slot = (home + probe) % capacity;
+            const auto examined = read_entry(directory, slot);
+            if (examined.is_occupied) {
+                if (entry_name(examined) == name) {
+                    throw Error{R"(file with name "{}" already exists)", name};
                 }
-                bytes_processed += sizeof(directory_entry);
-                return false;
-            }); // trying to find free slot position
+                continue;
+            }
+            if (!free_slot) {
+                free_slot = slot; // tombstone or empty slot
+            }
+            if (is_empty_slot(examined)) {
+                break;
+            }
+        }
 
-    if (!free_entry_slot) { // trying to allocate new blocks
-        const auto blocks_allocated = directory_descriptor.blocks_allocated(block_length);
-        const auto bytes_available = directory_descriptor.free_bytes(block_length, directory_descriptor.length);
-        const auto blocks_to_allocate = ((sizeof(Descriptor) - bytes_available) + block_length - 1) / block_length;
-        if (blocks_to_allocate + blocks_allocated > directory_descriptor.blocks.size()) {
-            throw Error("not enough space in directory to create a new file");
+        if (free_slot) {
+            write_entry(directory, *free_slot, entry);
+            return *free_slot;
         }
+        rehash_directory(dir, directory); // no slot close enough to the home one
+    }
+}
 
-        _io->read_block(bitmap_block_number, _block_buffer); // reading bitmap in main memory
-        if (blocks_to_allocate <= count_free_bits(_block_buffer, data_blocks_count())) { // allocate new blocks in a cached bitmap
-            allocate_blocks(directory_descriptor.blocks, blocks_allocated, blocks_to_allocate, block_length);
-        } else {
-            throw Error("not enough space on disk to create a new file");
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::rehash_directory(std::size_t dir, Descriptor& directory) {
+    const auto block_length = this->block_length();
+    const auto max_capacity = Descriptor::max_blocks(block_length) * block_length / entry_size;
+    const auto old_capacity = directory_capacity(directory);
+
+    std::vector<std::byte> bytes(old_capacity * entry_size);
+    const auto& old_blocks = file_blocks(directory, 0u, directory.blocks_allocated(block_length));
+    read_bytes_from_disk_blocks(bytes, old_blocks.begin(), old_blocks.end(),
+                                IOPosition{.block = 0u, .byte = 0u}); // whole table in one batch
+    std::vector<DirectoryEntry> entries(old_capacity);
+    for (std::size_t i = 0u; i < old_capacity; ++i) {
+        entries[i] = Packed<DirectoryEntry>::decode(std::span{bytes}.subspan(i * entry_size).first<entry_size>());
+    }
+    const auto tombstones = std::count_if(entries.begin(), entries.end(),
+                                          [](const auto& entry) { return !entry.is_occupied && !is_empty_slot(entry); });
+    std::erase_if(entries, [](const auto& entry) { return !entry.is_occupied; }); // tombstones are dropped
+
+    auto capacity = std::min(max_capacity, old_capacity == 0u
+            ? std::max<std::size_t>(1u, block_length / entry_size)
+            : old_capacity * 2u);
+    if (capacity == old_capacity && tombstones == 0) { // table can neither grow nor be compacted
+        throw Error("not enough space in directory to create a new file");
+    }
+
+    std::vector<DirectoryEntry> table;
+    std::vector<std::size_t> slots(entries.size());
+    const auto place = [&] {
+        table.assign(capacity, DirectoryEntry{{.is_occupied = false}});
+        for (std::size_t i = 0u; i < entries.size(); ++i) {
+            const auto home = hash_name(entry_name(entries[i])) % capacity;
+            std::size_t probe = 0u;
+            for (; probe < std::min(max_probe_length, capacity) && !is_empty_slot(table[(home + probe) % capacity]); ++probe) {}
+            if (probe == std::min(max_probe_length, capacity)) {
+                return false;
+            }
+            slots[i] = (home + probe) % capacity;
+            table[slots[i]] = entries[i];
         }
-        _io->write_block(bitmap_block_number, _block_buffer); // writing updated bitmap
+        return true;
+    };
+    while (!place()) {
+        if (capacity == max_capacity) {
+            throw Error("not enough space in directory to create a new file");
+        }
+        capacity = std::min(max_capacity, capacity * 2u);
+    }
 
+    const auto blocks_allocated = directory.blocks_allocated(block_length);
+    const auto blocks_needed = (capacity * entry_size + block_length - 1) / block_length;
+    if (const auto blocks = blocks_needed > blocks_allocated ? extend_file(directory, blocks_allocated, blocks_needed) : blocks_needed;
+        blocks < blocks_needed)
+    {
+        for (auto n = blocks_allocated; n < blocks; ++n) { // blocks beyond directory length would leak
+            free_block(file_block(directory, n));
+        }
+        update_descriptor(dir, directory); // keep indirect blocks allocated so far
+        throw Error("not enough space on disk to create a new file");
+    }
 
-        free_entry_slot.emplace(IOPosition::fromIndex(directory_descriptor.length, block_length));
+    directory.length = capacity * entry_size;
+    const auto& blocks = file_blocks(directory, 0u, blocks_needed);
+    bytes.resize(capacity * entry_size);
+    for (std::size_t i = 0u; i < capacity; ++i) {
+        Packed<DirectoryEntry>::encode(table[i], std::span{bytes}.subspan(i * entry_size).first<entry_size>());
+    }
+    write_bytes_to_disk_blocks(bytes, blocks.begin(), blocks.end(), IOPosition{.block = 0u, .byte = 0u});
 
-        directory_descriptor.length += sizeof(DirectoryEntry); // append directory entry to directory file
+    for (std::size_t i = 0u; i < entries.size(); ++i) { // entries moved, so do back references
+        auto descriptor = _descriptors[entries[i].descriptor_index];
+        descriptor.entry_slot = slots[i];
+        update_descriptor(entries[i].descriptor_index, descriptor);
     }
+}
 
-    const auto descriptor_index =
-            (free_descriptor_pos.value().block * block_length + free_descriptor_pos.value().byte) / sizeof(Descriptor);
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::create(Directory::index_type dir, const File &file) -> Directory::Entry::index_type {
+    if (std::size_t actual = file.name.size(), max = DirectoryEntry::max_filename_length; actual > max) {
+        throw Error{"filename is too long: maximal length is {} symbols, but given is {} symbols", max, actual};
+    }
+    if (file.name.empty()) {
+        throw Error{"filename must not be empty"};
+    }
+    if (_free_descriptors.empty()) {
+        throw Error{"not enough space to create file"};
+    }
 
+    const auto descriptor_index = _free_descriptors.back();
     auto directory_entry = DirectoryEntry{
         .name_length = file.name.size(),
         .descriptor_index = descriptor_index
@@ -220,192 +592,260 @@ auto Default::create(Directory::index_type dir, const File &file) -> Directory::
 
     std::copy(file.name.begin(), file.name.end(), directory_entry.name.begin()); // set filename to a directory entry
 
-    write_value_to_disk_blocks(directory_entry,
-                               directory_descriptor.blocks.begin(),
-                               directory_descriptor.blocks.begin() + directory_descriptor.blocks_allocated(block_length),
-                               free_entry_slot.value()); // write a new file entry
-
-    write_value_to_disk_blocks(directory_descriptor,
-                               _descriptor_blocks_indexes.begin(),
-                               _descriptor_blocks_indexes.end(),
-                               directory_position); // update directory descriptor
+    auto directory_descriptor = this->directory_descriptor(dir);
+    const auto slot = insert_entry(dir, directory_descriptor, directory_entry); // write a new file entry
+    update_descriptor(dir, directory_descriptor); // update directory descriptor
 
-    write_value_to_disk_blocks(Descriptor{},
-                               _descriptor_blocks_indexes.begin(),
-                               _descriptor_blocks_indexes.end(),
-                               free_descriptor_pos.value()); // write a new descriptor
+    update_descriptor(descriptor_index, Descriptor{
+        .entry_slot = slot,
+        .is_inline = !file.is_directory && block_length() >= Descriptor::inline_capacity, // spilled inline data has to fit in one block
+        .is_directory = file.is_directory
+    }); // write a new descriptor
+    _free_descriptors.pop_back();
 
     return descriptor_index;
 }
 
-auto Default::search(Directory::index_type dir, std::string_view name)
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::search(Directory::index_type dir, std::string_view name)
     const -> std::optional<Directory::Entry::index_type>
 {
-    const auto directory_descriptor = read_value_from_disk_blocks<Descriptor>(
-            _descriptor_blocks_indexes.begin(),
-            _descriptor_blocks_indexes.end(),
-            IOPosition{.block = 0u, .byte = 0u}).value();
-
-    std::optional<Directory::Entry::index_type> found_index{};
-
-    find_value_on_disk_blocks_if<DirectoryEntry>(
-            directory_descriptor.blocks.begin(),
-            directory_descriptor.blocks.end(),
-            [&found_index, name](const auto& entry) {
-                if (entry.is_occupied
-                    && std::equal(
-                        entry.name.begin(), entry.name.begin() + entry.name_length,
-                        name.begin(),       name.end())) {
-                    found_index = entry.descriptor_index;
-                    return true;
-                }
-                return false;
-            }
-        );
-
-    return found_index;
+    const auto& directory_descriptor = this->directory_descriptor(dir);
+    if (const auto slot = find_entry(directory_descriptor, name)) {
+        return read_entry(directory_descriptor, *slot).descriptor_index;
+    }
+    return std::nullopt;
 }
 
-void Default::remove(Directory::index_type dir, Directory::Entry::index_type index) {
-    const auto directory_descriptor = read_value_from_disk_blocks<Descriptor>(
-            _descriptor_blocks_indexes.begin(),
-            _descriptor_blocks_indexes.end(),
-            IOPosition{.block = 0u, .byte = 0u}).value();
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::remove(Directory::index_type dir, Directory::Entry::index_type index) {
+    const auto& directory_descriptor = this->directory_descriptor(dir);
+    const auto slot = _descriptors[index].entry_slot;
+    auto entry = read_entry(directory_descriptor, slot);
+    if (!entry.is_occupied || entry.descriptor_index != index) {
+        throw Error{"directory entry of file {} is corrupted", index};
+    }
+    if (_descriptors[index].is_directory && has_entries(_descriptors[index])) {
+        throw Error{R"(directory "{}" is not empty)", entry_name(entry)};
+    }
 
-    const auto block_length = _io->block_length();
+    entry.is_occupied = false; // tombstone keeps the name, so probe sequences passing it go on
+    write_entry(directory_descriptor, slot, entry); // remove directory entry
 
-    const auto entry_position = find_value_on_disk_blocks_if<DirectoryEntry>(
-            directory_descriptor.blocks.begin(),
-            directory_descriptor.blocks.begin() + directory_descriptor.blocks_allocated(block_length),
-            [index](const auto& entry) {
-                return entry.is_occupied && entry.descriptor_index == index;
-            }).value(); // get file entry position
+    free_file_blocks(_descriptors[index]); // free bitmap entries
+    update_descriptor(index, Descriptor{{.is_occupied = false}}); // free the descriptor
+    _free_descriptors.push_back(index);
+}
 
-    const auto descriptor_position = IOPosition::fromIndex(index * sizeof(Descriptor), block_length);
-    const auto descriptor = read_value_from_disk_blocks<Descriptor>(
-            _descriptor_blocks_indexes.begin(),
-            _descriptor_blocks_indexes.end(),
-            descriptor_position).value(); // read file descriptor
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::file_length(Directory::Entry::index_type index) const noexcept -> std::size_t {
+    const std::lock_guard lock{_metadata_mutex};
+    return _descriptors[index].length;
+}
 
-    _io->read_block(bitmap_block_number, _block_buffer); // read bitmap
-    for (auto it = descriptor.blocks.begin();
-            it != descriptor.blocks.begin() + descriptor.blocks_allocated(block_length); ++it) // free bitmap entries
-    {
-        set_bit(_block_buffer, *it - _k, false);
-    }
-    _io->write_block(bitmap_block_number, _block_buffer); // write updated bitmap
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::is_directory(Directory::Entry::index_type index) const -> bool {
+    const std::lock_guard lock{_metadata_mutex}; // path lookups check files that may be written meanwhile
+    return index < _descriptors.size() && _descriptors[index].is_occupied && _descriptors[index].is_directory;
+}
 
-    write_value_to_disk_blocks(
-            DirectoryEntry{{.is_occupied = false}},
-            directory_descriptor.blocks.begin(),
-            directory_descriptor.blocks.begin() + directory_descriptor.blocks_allocated(block_length),
-            entry_position); // remove directory entry
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::directory_descriptor(Directory::index_type dir) const -> const Descriptor& {
+    if (!is_directory(dir)) {
+        throw Error{"file {} is not a directory", dir};
+    }
+    return _descriptors[dir];
+}
 
-    write_value_to_disk_blocks(
-            Descriptor{{.is_occupied = false}},
-            _descriptor_blocks_indexes.begin(),
-            _descriptor_blocks_indexes.end(),
-            descriptor_position); // free the descriptor
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::has_entries(const Descriptor& directory) const -> bool {
+    const auto entries = directory_capacity(directory);
+    std::size_t entries_examined = 0u;
+    const auto& blocks = file_blocks(directory, 0u, directory.blocks_allocated(block_length()));
+    return find_value_on_disk_blocks_if<DirectoryEntry>(
+            blocks.begin(),
+            blocks.end(),
+            [&entries_examined, entries](const auto& entry) { return entries_examined++ < entries && entry.is_occupied; })
+        .has_value();
 }
 
-void Default::close(Directory::Entry::index_type index) {
-    // no additional logic on file closing
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::close(Directory::Entry::index_type index) {
+    flush_descriptors(); // descriptors modified while file was open go to disk
 }
 
-auto Default::write(Directory::Entry::index_type index, std::size_t pos,
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::write(Directory::Entry::index_type index, std::size_t pos,
                     std::span<const std::byte> src) -> std::size_t
 {
-    const auto block_length = _io->block_length();
-    const auto descriptor_pos = IOPosition::fromIndex(index * sizeof(Descriptor), block_length);
-    auto entry_descriptor = read_value_from_disk_blocks<Descriptor>(
-            _descriptor_blocks_indexes.begin(),
-            _descriptor_blocks_indexes.end(),
-            descriptor_pos).value();
+    if (src.empty()) {
+        return 0u;
+    }
+
+    const auto block_length = this->block_length();
+    auto entry_descriptor = _descriptors[index];
 
-    std::size_t new_blocks_allocated = 0u;
-    if (entry_descriptor.free_bytes(block_length, pos) < src.size()) { // allocating new blocks
-        const auto blocks_allocated = entry_descriptor.blocks_allocated(block_length);
-        const auto bytes_available = entry_descriptor.free_bytes(block_length, pos);
-        const auto blocks_to_allocate = (src.size() - bytes_available) + block_length / block_length;
+    if (entry_descriptor.is_inline) {
+        if (pos + src.size() <= Descriptor::inline_capacity || !spill_inline_data(entry_descriptor)) { // small file stays in the descriptor
+            const auto written = write_inline_data(entry_descriptor, pos, src);
+            update_descriptor(index, entry_descriptor);
+            return written;
+        }
+    }
 
-        _io->read_block(bitmap_block_number, _block_buffer); // read bitmap from disk
-        new_blocks_allocated = allocate_blocks(
-                entry_descriptor.blocks,
-                blocks_allocated,
-                blocks_to_allocate,
-                block_length); // allocating as much blocks as possible
-        _io->write_block(bitmap_block_number, _block_buffer); // write bitmap to disk
+    auto blocks_available = entry_descriptor.blocks_allocated(block_length);
+    if (const auto blocks_needed = std::min((pos + src.size() + block_length - 1) / block_length,
+                                            Descriptor::max_blocks(block_length));
+        blocks_needed > blocks_available)
+    {
+        blocks_available = extend_file(entry_descriptor, blocks_available, blocks_needed); // allocating as much blocks as possible
+    }
+    const auto end = std::min(pos + src.size(), blocks_available * block_length);
+
+    if (pos > entry_descriptor.length) { // fill the gap left by seeking past the end with zeros
+        const std::vector<std::byte> zeros(block_length);
+        for (auto offset = entry_descriptor.length; offset < std::min(pos, end);) {
+            const auto chunk = std::min(block_length - offset % block_length, std::min(pos, end) - offset);
+            const auto& gap_blocks = file_blocks(entry_descriptor, offset / block_length, offset / block_length + 1);
+            write_bytes_to_disk_blocks(std::span{zeros}.first(chunk), gap_blocks.begin(), gap_blocks.end(),
+                                       IOPosition{.block = 0u, .byte = offset % block_length});
+            offset += chunk;
+        }
     }
 
-    entry_descriptor.length = std::min(
-            (entry_descriptor.blocks_allocated(block_length) + new_blocks_allocated) * block_length,
-            entry_descriptor.length + src.size()); // extending file length
+    entry_descriptor.length = std::max(entry_descriptor.length, end); // extending file length
+    if (entry_descriptor != _descriptors[index]) {
+        update_descriptor(index, entry_descriptor); // overwriting data leaves descriptor intact
+    }
 
-    write_value_to_disk_blocks(
-            entry_descriptor,
-            _descriptor_blocks_indexes.begin(),
-            _descriptor_blocks_indexes.end(),
-            descriptor_pos); // write updated descriptor
+    if (pos >= end) {
+        return 0u;
+    }
 
+    const auto& blocks = file_blocks(entry_descriptor, pos / block_length, (end + block_length - 1) / block_length);
     return write_bytes_to_disk_blocks(
-            src,
-            entry_descriptor.blocks.begin(),
-            entry_descriptor.blocks.begin() + entry_descriptor.blocks_allocated(block_length),
-            IOPosition::fromIndex(pos, block_length));
+            src.first(end - pos),
+            blocks.begin(),
+            blocks.end(),
+            IOPosition{.block = 0u, .byte = pos % block_length});
 }
 
-auto Default::read(Directory::Entry::index_type index, std::size_t pos, std::span<std::byte> dst) const -> std::size_t {
-    const auto block_length = _io->block_length();
-    const auto entry_descriptor = read_value_from_disk_blocks<Descriptor>(
-            _descriptor_blocks_indexes.begin(),
-            _descriptor_blocks_indexes.end(),
-            IOPosition::fromIndex(index * sizeof(Descriptor), block_length)).value();
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::read(Directory::Entry::index_type index, std::size_t pos, std::span<std::byte> dst) const -> std::size_t {
+    const auto block_length = this->block_length();
+    const auto& entry_descriptor = _descriptors[index];
 
     if (pos >= entry_descriptor.length) {
         return 0u;
     }
 
+    const auto end = pos + std::min(dst.size(), entry_descriptor.length - pos);
+    if (entry_descriptor.is_inline) { // small file is read without touching data blocks
+        std::copy(entry_descriptor.data.begin() + pos, entry_descriptor.data.begin() + end, dst.begin());
+        return end - pos;
+    }
+
+    const auto& blocks = file_blocks(entry_descriptor, pos / block_length, (end + block_length - 1) / block_length); // only blocks in range are resolved
     return read_bytes_from_disk_blocks(
-            std::span(dst.begin(), dst.begin() + std::min(dst.size(), entry_descriptor.length - pos)),
-            entry_descriptor.blocks.begin(),
-            entry_descriptor.blocks.begin() + entry_descriptor.blocks_allocated(block_length),
-            IOPosition::fromIndex(pos, block_length));
+            dst.first(end - pos),
+            blocks.begin(),
+            blocks.end(),
+            IOPosition{.block = 0u, .byte = pos % block_length});
 }
 
-auto Default::get(Directory::index_type dir) const -> std::optional<Directory> {
-    auto directory = std::optional{Directory{.index = dir}};
-    const auto directory_descriptor = read_value_from_disk_blocks<Descriptor>(
-            _descriptor_blocks_indexes.begin(),
-            _descriptor_blocks_indexes.end(),
-            IOPosition{.block = 0u, .byte = 0u}).value(); // read directory descriptor
-
-    find_value_on_disk_blocks_if<DirectoryEntry>(
-            directory_descriptor.blocks.begin(),
-            directory_descriptor.blocks.begin() + directory_descriptor.blocks_allocated(_io->block_length()),
-            [&directory](const auto& entry) {
-                if (entry.is_occupied) {
-                    directory->entries.push_back({
-                            0u,
-                            std::string{entry.name.begin(), entry.name.begin() + entry.name_length},
-                            static_cast<Directory::index_type>(entry.descriptor_index)}); // add a new file entry
-                }
-                return false;
-            });
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::get(Directory::index_type dir) const -> std::shared_ptr<const Directory> {
+    return std::make_shared<const Directory>(list_directory(dir));
+}
 
-    for (auto& entry : directory->entries) {
-        entry.size = read_value_from_disk_blocks<Descriptor>(
-                _descriptor_blocks_indexes.begin(),
-                _descriptor_blocks_indexes.end(),
-                IOPosition::fromIndex(entry.index * sizeof(Descriptor), _io->block_length())
-            )->length; // get file length from descriptor
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::list_directory(Directory::index_type dir) const -> Directory {
+    auto directory = Directory{.index = dir};
+    const auto& directory_descriptor = this->directory_descriptor(dir);
+
+    const auto& directory_blocks = file_blocks(directory_descriptor, 0u, directory_descriptor.blocks_allocated(block_length()));
+    auto cursor = BlockCursor<DirectoryEntry>{std::as_const(*_io), directory_blocks, 0u, block_length()};
+    const std::lock_guard lock{_metadata_mutex}; // lengths of listed files may be updated by their writers
+    for (auto slot = directory_capacity(directory_descriptor); slot > 0u && !cursor.done(); --slot, cursor.next()) {
+        if (const auto entry = cursor.get(); entry.is_occupied) { // kind and length come from resident descriptor in the same pass
+            const auto& descriptor = _descriptors[entry.descriptor_index];
+            directory.entries.push_back({
+                    File{.size = descriptor.is_directory ? 0u : descriptor.length, // hash table size says nothing about directory content
+                         .name = std::string{entry_name(entry)},
+                         .is_directory = descriptor.is_directory},
+                    static_cast<Directory::index_type>(entry.descriptor_index)});
+        }
     }
+    std::sort(directory.entries.begin(), directory.entries.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.name < rhs.name; }); // hashed slots are unordered
 
     return directory;
 }
 
-void Default::save(const std::string_view path) const
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::for_each_entry(Directory::index_type dir, std::string_view prefix, const EntryVisitor& visitor) const {
+    const auto& directory_descriptor = this->directory_descriptor(dir);
+
+    const std::vector<std::size_t> directory_blocks = file_blocks(directory_descriptor, 0u, directory_descriptor.blocks_allocated(block_length())); // copied, as visitor may refill scratch buffers
+    Directory::Entry file{File{.size = 0u, .name = {}}, 0u}; // reused, so its name keeps the buffer between entries
+    auto cursor = BlockCursor<DirectoryEntry>{std::as_const(*_io), directory_blocks, 0u, block_length()};
+    for (auto slot = directory_capacity(directory_descriptor); slot > 0u && !cursor.done(); --slot, cursor.next()) {
+        const auto entry = cursor.get();
+        if (!entry.is_occupied || !entry_name(entry).starts_with(prefix)) {
+            continue;
+        }
+        {
+            const std::lock_guard lock{_metadata_mutex}; // released before calling visitor, which may use the core
+            const auto& descriptor = _descriptors[entry.descriptor_index];
+            file.size = descriptor.is_directory ? 0u : descriptor.length;
+            file.is_directory = descriptor.is_directory;
+        }
+        file.name = entry_name(entry);
+        file.index = static_cast<Directory::Entry::index_type>(entry.descriptor_index);
+        if (!visitor(file)) {
+            return;
+        }
+    }
+}
+
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::save(const std::string_view path, const IO::Format format)
 {
-    _io->save(path);
+    flush_descriptors();
+    _io->save(path, format);
 }
 
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::flush()
+{
+    flush_descriptors();
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::io_stats() const -> io::LatencyModel::Stats
+{
+    return _io->stats();
+}
+
+template <std::size_t BlockLength>
+auto BasicDefault<BlockLength>::cache_stats() const -> std::optional<PageCache::Stats>
+{
+    return std::nullopt;
+}
+
+template <std::size_t BlockLength>
+void BasicDefault<BlockLength>::reset_stats()
+{
+    _io->reset_stats();
+}
+
+template class BasicDefault<dynamic_block_length>;
+template class BasicDefault<64u>;
+template class BasicDefault<128u>;
+template class BasicDefault<256u>;
+template class BasicDefault<512u>;
+template class BasicDefault<1024u>;
+template class BasicDefault<2048u>;
+template class BasicDefault<4096u>;
+
 } // namespace fs::core
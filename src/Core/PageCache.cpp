@@ -0,0 +1,188 @@
+#include <Core/PageCache.hpp>
+
+#include <algorithm>
+
+namespace fs::core {
+
+PageCache::PageCache(std::size_t capacity, Policy policy)
+    : _capacity{std::max<std::size_t>(capacity, 1u)}
+    , _policy{policy}
+{}
+
+auto PageCache::find(const Key& key) -> Page* {
+    const auto it = _pages.find(key);
+    if (it == _pages.end()) {
+        ++_stats.misses;
+        return nullptr;
+    }
+
+    ++_stats.hits;
+    auto& entry = it->second;
+    switch (_policy) {
+    case Policy::lru:
+        move_to_front(_recent, entry.position, _recent);
+        break;
+    case Policy::clock:
+        entry.referenced = true; // hand gives the page a second chance
+        break;
+    case Policy::arc:
+        move_to_front(entry.frequent ? _frequent : _recent, entry.position, _frequent); // page used twice is frequent
+        entry.frequent = true;
+        break;
+    }
+    return &entry.page;
+}
+
+auto PageCache::peek(const Key& key) -> Page* {
+    const auto it = _pages.find(key);
+    return it == _pages.end() ? nullptr : &it->second.page;
+}
+
+auto PageCache::insert(const Key& key, Page page) -> std::optional<std::pair<Key, Page>> {
+    if (const auto it = _pages.find(key); it != _pages.end()) {
+        it->second.page = std::move(page);
+        return std::nullopt;
+    }
+
+    std::optional<std::pair<Key, Page>> victim;
+    bool frequent = false;
+    if (_policy != Policy::arc) {
+        if (_pages.size() >= _capacity) {
+            victim = evict(false);
+        }
+    } else if (const auto ghost = _ghosts.find(key); ghost != _ghosts.end()) { // page evicted recently is needed again
+        frequent = true;
+        const auto frequent_ghost_hit = ghost->second.frequent;
+        if (frequent_ghost_hit) { // frequent pages were evicted too early, shrink target of recent ones
+            _recent_target -= std::min(_recent_target,
+                                       std::max<std::size_t>(_recent_ghosts.size() / _frequent_ghosts.size(), 1u));
+            _frequent_ghosts.erase(ghost->second.position);
+        } else { // recent pages were evicted too early, grow their target
+            _recent_target = std::min(_capacity,
+                                      _recent_target + std::max<std::size_t>(_frequent_ghosts.size() / _recent_ghosts.size(), 1u));
+            _recent_ghosts.erase(ghost->second.position);
+        }
+        _ghosts.erase(ghost);
+        if (_pages.size() >= _capacity) {
+            victim = evict(frequent_ghost_hit);
+        }
+    } else if (const auto recent_total = _recent.size() + _recent_ghosts.size(); recent_total >= _capacity) {
+        if (_recent.size() < _capacity) {
+            drop_ghost(_recent_ghosts);
+            if (_pages.size() >= _capacity) {
+                victim = evict(false);
+            }
+        } else { // recent pages alone fill the cache, their history is useless
+            victim = evict_from(_recent, nullptr, false);
+        }
+    } else if (const auto total = recent_total + _frequent.size() + _frequent_ghosts.size(); total >= _capacity) {
+        if (total >= 2u * _capacity) {
+            drop_ghost(_frequent_ghosts);
+        }
+        if (_pages.size() >= _capacity) {
+            victim = evict(false);
+        }
+    }
+
+    auto& queue = frequent ? _frequent : _recent;
+    queue.push_front(key); // for CLOCK the front is just behind the hand, so new page is examined last
+    _pages.emplace(key, Entry{.page = std::move(page), .position = queue.begin(), .frequent = frequent, .referenced = false});
+    return victim;
+}
+
+void PageCache::erase_file(Directory::Entry::index_type file) {
+    for (auto it = _pages.begin(); it != _pages.end();) {
+        if (it->first.file == file) {
+            (it->second.frequent ? _frequent : _recent).erase(it->second.position);
+            it = _pages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = _ghosts.begin(); it != _ghosts.end();) {
+        if (it->first.file == file) {
+            (it->second.frequent ? _frequent_ghosts : _recent_ghosts).erase(it->second.position);
+            it = _ghosts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+auto PageCache::size() const noexcept -> std::size_t {
+    return _pages.size();
+}
+
+auto PageCache::capacity() const noexcept -> std::size_t {
+    return _capacity;
+}
+
+auto PageCache::policy() const noexcept -> Policy {
+    return _policy;
+}
+
+auto PageCache::stats() const noexcept -> const Stats& {
+    return _stats;
+}
+
+void PageCache::reset_stats() noexcept {
+    _stats = {};
+}
+
+void PageCache::move_to_front(Queue& from, Queue::iterator position, Queue& to) {
+    to.splice(to.begin(), from, position);
+}
+
+auto PageCache::evict(bool frequent_ghost_hit) -> std::pair<Key, Page> {
+    switch (_policy) {
+    case Policy::lru:
+        break;
+    case Policy::clock:
+        for (;;) { // hand at the back skips referenced pages clearing their bits
+            auto& entry = _pages.find(_recent.back())->second;
+            if (!entry.referenced) {
+                break;
+            }
+            entry.referenced = false;
+            move_to_front(_recent, entry.position, _recent);
+        }
+        break;
+    case Policy::arc:
+        if (!_recent.empty()
+            && (_recent.size() > _recent_target || (frequent_ghost_hit && _recent.size() == _recent_target)))
+        {
+            return evict_from(_recent, &_recent_ghosts, false);
+        }
+        if (!_frequent.empty()) {
+            return evict_from(_frequent, &_frequent_ghosts, true);
+        }
+        return evict_from(_recent, &_recent_ghosts, false);
+    }
+    return evict_from(_recent, nullptr, false);
+}
+
+auto PageCache::evict_from(Queue& queue, Queue* ghosts, bool frequent) -> std::pair<Key, Page> {
+    const auto key = queue.back();
+    queue.pop_back();
+    auto node = _pages.extract(key);
+    ++_stats.evictions;
+
+    if (ghosts != nullptr) {
+        ghosts->push_front(key);
+        _ghosts.insert_or_assign(key, Ghost{.position = ghosts->begin(), .frequent = frequent});
+        if (ghosts->size() > _capacity) { // history never needs to be longer than the cache
+            drop_ghost(*ghosts);
+        }
+    }
+    return {key, std::move(node.mapped().page)};
+}
+
+void PageCache::drop_ghost(Queue& queue) {
+    if (queue.empty()) {
+        return;
+    }
+    _ghosts.erase(queue.back());
+    queue.pop_back();
+}
+
+} // namespace fs::core
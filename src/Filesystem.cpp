@@ -1,39 +1,190 @@
 #include <Filesystem.hpp>
 
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
 namespace fs {
 
 Filesystem::Filesystem(core::Interface::Ptr core) noexcept :
     _core{std::move(core)}
 { }
 
+auto Filesystem::find_handle(const file_index_type index) const -> std::shared_ptr<Handle>
+{
+    const auto slot = index & ((file_index_type{1} << generation_shift) - 1);
+    auto& shard = _oft[slot % oft_shards];
+    const std::lock_guard lock{shard.mutex};
+    if (const auto local = slot / oft_shards; local < shard.slots.size()
+        && shard.slots[local].handle != nullptr
+        && shard.slots[local].generation == index >> generation_shift)
+    {
+        return shard.slots[local].handle;
+    }
+    throw Error{"file is not opened"};
+}
+
+void Filesystem::release_slot(Shard& shard, const Handle& handle)
+{
+    const auto local = handle.slot / oft_shards;
+    if (--handle.open_file->handles == 0) {
+        shard.files.erase(handle.file);
+    }
+    ++shard.slots[local].generation;    // stale indices of the handle stop matching the slot
+    shard.free_slots.push_back(local);
+    shard.slots[local].handle = nullptr;    // may free the handle, it is not used after that
+}
+
+void Filesystem::close_all()
+{
+    for (auto& shard : _oft) {
+        for (const auto& [file, _] : shard.files) {
+            _core->close(file);
+        }
+        for (auto& slot : shard.slots) {
+            if (slot.handle != nullptr) {
+                slot.handle->is_open = false;
+                release_slot(shard, *slot.handle);
+            }
+        }
+    }
+}
+
+auto Filesystem::walk(const std::string_view path) const -> std::vector<Directory::index_type>
+{
+    auto directories = path.starts_with('/') ? std::vector{core::Interface::kRoot} : _cwd;
+    for (std::size_t first = 0; first < path.size();) {
+        const auto last = std::min(path.find('/', first), path.size());
+        const auto name = path.substr(first, last - first);
+        first = last + 1;
+
+        if (name.empty() || name == ".") {
+            continue;
+        }
+        if (name == "..") {
+            if (directories.size() > 1) {
+                directories.pop_back();
+            }
+            continue;
+        }
+        const auto directory = _core->search(directories.back(), name);
+        if (!directory.has_value()) {
+            throw Error{R"(directory with name "{}" does not exist)", name};
+        }
+        if (!_core->is_directory(*directory)) {
+            throw Error{R"("{}" is not a directory)", name};
+        }
+        directories.push_back(*directory);
+    }
+    return directories;
+}
+
+auto Filesystem::resolve(const std::string_view path) const -> std::pair<Directory::index_type, std::string_view>
+{
+    const auto slash = path.rfind('/');
+    const auto name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+    if (name.empty() || name == "." || name == "..") {
+        throw Error{R"(path "{}" does not name a file)", path};
+    }
+    if (slash == std::string_view::npos) {
+        return {_cwd.back(), name};
+    }
+    return {walk(path.substr(0, slash + 1)).back(), name};
+}
+
 void Filesystem::create(const std::string_view name)
 {
-    if (_core->search(_cd, name).has_value()) {
+    const std::unique_lock lock{_namespace};
+    const auto [dir, file_name] = resolve(name);
+    if (_core->search(dir, file_name).has_value()) {
         throw Error{R"(file with name "{}" already exists)", name};
     }
-    _core->create(_cd, File{.size = 0, .name = std::string{name}});
+    _core->create(dir, File{.size = 0, .name = std::string{file_name}});
 }
 
 void Filesystem::destroy(const std::string_view name)
 {
-    if (auto file_index = _core->search(_cd, name); !file_index.has_value()) {
+    const std::unique_lock lock{_namespace};
+    const auto [dir, file_name] = resolve(name);
+    if (auto file_index = _core->search(dir, file_name); !file_index.has_value()) {
         throw Error{R"(file with name "{}" does not exist)", name};
     }
+    else if (_core->is_directory(*file_index)) {
+        throw Error{R"("{}" is a directory)", name};
+    }
     else {
-        _core->remove(_cd, *file_index);
-        _oft.erase(*file_index);
+        _core->remove(dir, *file_index);
+        auto& shard = _oft[*file_index % oft_shards];
+        for (auto& slot : shard.slots) {    // nobody uses handles of the file, namespace is held exclusively
+            if (slot.handle != nullptr && slot.handle->file == *file_index) {
+                slot.handle->is_open = false;
+                release_slot(shard, *slot.handle);
+            }
+        }
     }
 }
 
+void Filesystem::make_directory(const std::string_view name)
+{
+    const std::unique_lock lock{_namespace};
+    const auto [dir, file_name] = resolve(name);
+    if (_core->search(dir, file_name).has_value()) {
+        throw Error{R"(file with name "{}" already exists)", name};
+    }
+    _core->create(dir, File{.size = 0, .name = std::string{file_name}, .is_directory = true});
+}
+
+void Filesystem::remove_directory(const std::string_view name)
+{
+    const std::unique_lock lock{_namespace};
+    const auto [dir, file_name] = resolve(name);
+    if (auto file_index = _core->search(dir, file_name); !file_index.has_value()) {
+        throw Error{R"(directory with name "{}" does not exist)", name};
+    }
+    else if (!_core->is_directory(*file_index)) {
+        throw Error{R"("{}" is not a directory)", name};
+    }
+    else if (std::find(_cwd.begin(), _cwd.end(), *file_index) != _cwd.end()) {
+        throw Error{R"(directory "{}" is in use)", name};
+    }
+    else {
+        _core->remove(dir, *file_index);
+    }
+}
+
+void Filesystem::change_directory(const std::string_view name)
+{
+    const std::unique_lock lock{_namespace};
+    _cwd = walk(name);
+}
+
 auto Filesystem::open(const std::string_view name) -> file_index_type
 {
-    if (auto file = _core->search(_cd, name); file.has_value()) {
-        if (_oft.contains(*file)) {
-            throw Error{"file is already open."};
-        } else {
-            _oft[*file] = 0;
-            return *file;
+    const std::shared_lock lock{_namespace};
+    const auto [dir, file_name] = resolve(name);
+    if (auto file = _core->search(dir, file_name); file.has_value()) {
+        if (_core->is_directory(*file)) {
+            throw Error{R"("{}" is a directory)", name};
+        }
+        auto& shard = _oft[*file % oft_shards];
+        const std::lock_guard shard_lock{shard.mutex};
+        auto& open_file = shard.files[*file];
+        if (open_file == nullptr) {
+            open_file = std::make_shared<OpenFile>();
         }
+        if (shard.free_slots.empty()) {
+            shard.free_slots.push_back(shard.slots.size());
+            shard.slots.emplace_back();
+        }
+        const auto local = shard.free_slots.back();
+        shard.free_slots.pop_back();
+        auto& slot = shard.slots[local];
+        slot.handle = std::make_shared<Handle>();
+        slot.handle->slot = local * oft_shards + *file % oft_shards;
+        slot.handle->file = *file;
+        slot.handle->open_file = open_file;
+        ++open_file->handles;
+        return static_cast<file_index_type>(slot.generation) << generation_shift | slot.handle->slot;
     } else {
         throw Error{"file with name {} is not found", name};
     }
@@ -41,59 +192,118 @@ auto Filesystem::open(const std::string_view name) -> file_index_type
 
 void Filesystem::close(const file_index_type index)
 {
-    if (auto it = _oft.find(index); it != _oft.end()) {
-        _core->close(index);
-        _oft.erase(it);
-        return;
+    const std::shared_lock lock{_namespace};
+    const auto handle = find_handle(index);
+    const std::unique_lock file_lock{handle->open_file->mutex};    // operations already running on the file finish first
+    if (!handle->is_open) {    // closed by another thread meanwhile
+        throw Error{"file is not opened"};
     }
-    throw Error{"file is not opened"};
+    _core->close(handle->file);
+    auto& shard = _oft[handle->file % oft_shards];
+    const std::lock_guard shard_lock{shard.mutex};
+    handle->is_open = false;
+    release_slot(shard, *handle);
 }
 
 auto Filesystem::read(const file_index_type index, std::span<std::byte> dst) const -> std::size_t
 {
-    if (auto it = _oft.find(index); it != _oft.end()) {
-        const auto read = _core->read(index, it->second, dst);
-        it->second += read;
-        return read;
-    }
-    throw Error{"file is not opened"};
+    const std::shared_lock lock{_namespace};
+    const auto handle = find_handle(index);
+    const std::lock_guard handle_lock{handle->mutex};
+    const auto read = pread(*handle, handle->position, dst);
+    handle->position += read;
+    return read;
 };
 
 auto Filesystem::write(const file_index_type index, const std::span<const std::byte> src) -> std::size_t
 {
-    if (auto it = _oft.find(index); it != _oft.end()) {
-        const auto written = _core->write(index, it->second, src);
-        it->second += written;
-        return written;
-    }
-    throw Error{"file is not opened"};
+    const std::shared_lock lock{_namespace};
+    const auto handle = find_handle(index);
+    const std::lock_guard handle_lock{handle->mutex};
+    const auto written = pwrite(*handle, handle->position, src);
+    handle->position += written;
+    return written;
 }
 
 void Filesystem::lseek(const file_index_type index, const std::size_t pos)
 {
-    if (auto it = _oft.find(index); it != _oft.end()) {
-        it->second = pos;
-        return;
-    }
-    throw Error{"file is not opened"};
+    const std::shared_lock lock{_namespace};
+    const auto handle = find_handle(index);
+    const std::lock_guard handle_lock{handle->mutex};
+    handle->position = pos;
+}
+
+auto Filesystem::pread(const file_index_type index, const std::size_t pos, std::span<std::byte> dst) const -> std::size_t
+{
+    const std::shared_lock lock{_namespace};
+    return pread(*find_handle(index), pos, dst);
 }
 
-auto Filesystem::directory() const -> std::vector<File>
+auto Filesystem::pwrite(const file_index_type index, const std::size_t pos, const std::span<const std::byte> src) -> std::size_t
 {
-    auto res = std::vector<File>{};
-    auto entries = _core->get(_cd)->entries;
-    std::transform(entries.begin(), entries.end(), std::back_inserter(res),
-                   [] (auto& entry) -> File&& {return std::move(entry);});
-    return res;
+    const std::shared_lock lock{_namespace};
+    return pwrite(*find_handle(index), pos, src);
+}
+
+auto Filesystem::pread(const Handle& handle, const std::size_t pos, std::span<std::byte> dst) const -> std::size_t
+{
+    const std::shared_lock file_lock{handle.open_file->mutex};    // readers of the file share it
+    if (!handle.is_open) {
+        throw Error{"file is not opened"};
+    }
+    return _core->read(handle.file, pos, dst);
 }
 
-void Filesystem::save(const std::string_view path)
+auto Filesystem::pwrite(const Handle& handle, const std::size_t pos, const std::span<const std::byte> src) -> std::size_t
 {
-    for (const auto& [file, _] : _oft) {
-        close(file);
+    const std::unique_lock file_lock{handle.open_file->mutex};
+    if (!handle.is_open) {
+        throw Error{"file is not opened"};
     }
-    _oft.clear();
-    _core->save(path);
+    return _core->write(handle.file, pos, src);
+}
+
+auto Filesystem::directory() const -> std::shared_ptr<const Directory>
+{
+    const std::shared_lock lock{_namespace};
+    return _core->get(_cwd.back()); // listing is shared with the core, not copied
+}
+
+void Filesystem::for_each_file(const std::string_view prefix, const core::Interface::EntryVisitor& visitor) const
+{
+    const std::shared_lock lock{_namespace};    // held across visitor, so it must not re-enter the filesystem
+    _core->for_each_entry(_cwd.back(), prefix, visitor);
+}
+
+void Filesystem::flush()
+{
+    const std::unique_lock lock{_namespace};    // pending data of every file goes to disk, none may be written meanwhile
+    _core->flush();
+}
+
+void Filesystem::save(const std::string_view path, const IO::Format format)
+{
+    const std::unique_lock lock{_namespace};
+    close_all();
+    _core->save(path, format);
+}
+
+auto Filesystem::io_stats() const -> io::LatencyModel::Stats
+{
+    const std::shared_lock lock{_namespace};
+    return _core->io_stats();
+}
+
+auto Filesystem::cache_stats() const -> std::optional<core::PageCache::Stats>
+{
+    const std::shared_lock lock{_namespace};
+    return _core->cache_stats();
+}
+
+void Filesystem::reset_stats()
+{
+    const std::shared_lock lock{_namespace};
+    _core->reset_stats();
 }
 
 } // namespace fs
@@ -1,54 +1,546 @@
 #include <IO.hpp>
+#include <IO/Compression.hpp>
+#include <Packed.hpp>
+#include <Error.hpp>
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <filesystem>
 #include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief Owns POSIX file descriptor.
+ */
+struct FileDescriptor
+{
+    int fd;
+
+    explicit FileDescriptor(int fd) noexcept : fd{fd} {}
+    FileDescriptor(const FileDescriptor&) = delete;
+    ~FileDescriptor() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+};
+
+[[noreturn]]
+void throw_system_error(std::string_view what, std::string_view path) {
+    throw fs::Error{"{} {}: {}", what, path, std::strerror(errno)};
+}
+
+/**
+ * @brief Geometry of a disk with unknown layout: a single track.
+ */
+auto single_track(std::size_t nblocks) noexcept -> fs::io::Geometry {
+    return {.cylinders = 1u, .tracks = 1u, .sectors = std::max<std::size_t>(nblocks, 1u)};
+}
+
+/**
+ * @brief Compact image layout: header, table with entry for every chunk of blocks, stored chunks.
+ *        Chunk stores only its non-zero blocks, compressed unless that does not make them smaller.
+ */
+constexpr std::array<char, 8> compact_magic = {'F', 'S', 'L', 'A', 'B', 'I', 'M', 'G'};
+constexpr std::uint32_t compact_version = 1u;
+constexpr std::size_t chunk_target_bytes = 64u * 1024u;  // bounds work needed to access a single block
+
+struct CompactHeader
+{
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t blocks_per_chunk;
+    std::uint64_t nblocks;
+    std::uint64_t block_length;
+};
+
+struct ChunkEntry
+{
+    std::uint64_t offset;         // of stored chunk in image
+    std::uint64_t stored_blocks;  // bit i is set if ith block of chunk is stored, other blocks are zero
+    std::uint32_t stored_size;    // size of stored chunk, uncompressed if equal to stored blocks length
+    std::uint32_t reserved;
+};
+
+} // namespace
+
+/**
+ * @brief Compact image structures are stored in little-endian order on any host.
+ */
+template <>
+struct fs::Packed<CompactHeader> {
+    static constexpr std::size_t magic_offset = 0u;
+    static constexpr std::size_t version_offset = magic_offset + compact_magic.size();
+    static constexpr std::size_t blocks_per_chunk_offset = version_offset + sizeof(std::uint32_t);
+    static constexpr std::size_t nblocks_offset = blocks_per_chunk_offset + sizeof(std::uint32_t);
+    static constexpr std::size_t block_length_offset = nblocks_offset + sizeof(std::uint64_t);
+    static constexpr std::size_t size = block_length_offset + sizeof(std::uint64_t);
+
+    static constexpr void encode(const CompactHeader& header, std::span<std::byte, size> to) noexcept {
+        std::transform(header.magic.begin(), header.magic.end(), to.begin() + magic_offset,
+                       [](char c) { return static_cast<std::byte>(c); });
+        layout::store(to, version_offset, header.version);
+        layout::store(to, blocks_per_chunk_offset, header.blocks_per_chunk);
+        layout::store(to, nblocks_offset, header.nblocks);
+        layout::store(to, block_length_offset, header.block_length);
+    }
+
+    static constexpr auto decode(std::span<const std::byte, size> from) noexcept -> CompactHeader {
+        CompactHeader header;
+        std::transform(from.begin() + magic_offset, from.begin() + version_offset, header.magic.begin(),
+                       [](std::byte b) { return static_cast<char>(b); });
+        header.version = layout::load<std::uint32_t>(from, version_offset);
+        header.blocks_per_chunk = layout::load<std::uint32_t>(from, blocks_per_chunk_offset);
+        header.nblocks = layout::load<std::uint64_t>(from, nblocks_offset);
+        header.block_length = layout::load<std::uint64_t>(from, block_length_offset);
+        return header;
+    }
+};
+
+template <>
+struct fs::Packed<ChunkEntry> {
+    static constexpr std::size_t offset_offset = 0u;
+    static constexpr std::size_t stored_blocks_offset = offset_offset + sizeof(std::uint64_t);
+    static constexpr std::size_t stored_size_offset = stored_blocks_offset + sizeof(std::uint64_t);
+    static constexpr std::size_t size = stored_size_offset + 2 * sizeof(std::uint32_t); // reserved field
+
+    static constexpr void encode(const ChunkEntry& entry, std::span<std::byte, size> to) noexcept {
+        std::fill(to.begin(), to.end(), std::byte{0});
+        layout::store(to, offset_offset, entry.offset);
+        layout::store(to, stored_blocks_offset, entry.stored_blocks);
+        layout::store(to, stored_size_offset, entry.stored_size);
+    }
+
+    static constexpr auto decode(std::span<const std::byte, size> from) noexcept -> ChunkEntry {
+        return ChunkEntry{.offset = layout::load<std::uint64_t>(from, offset_offset),
+                          .stored_blocks = layout::load<std::uint64_t>(from, stored_blocks_offset),
+                          .stored_size = layout::load<std::uint32_t>(from, stored_size_offset),
+                          .reserved = 0u};
+    }
+};
+
+namespace {
+
+using fs::Packed;
+
+constexpr std::size_t header_size = Packed<CompactHeader>::size;
+constexpr std::size_t entry_size = Packed<ChunkEntry>::size;
+
+/**
+ * @brief Reads #count packed chunk entries from current position of #file
+ */
+auto read_chunk_table(std::istream& file, std::size_t count) -> std::optional<std::vector<ChunkEntry>> {
+    std::vector<std::byte> bytes(count * entry_size);
+    if (!file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+        return std::nullopt;
+    }
+    std::vector<ChunkEntry> table(count);
+    for (std::size_t i = 0u; i < count; ++i) {
+        table[i] = Packed<ChunkEntry>::decode(std::span{bytes}.subspan(i * entry_size).first<entry_size>());
+    }
+    return table;
+}
+
+void write_chunk_table(std::ostream& file, const std::vector<ChunkEntry>& table) {
+    std::vector<std::byte> bytes(table.size() * entry_size);
+    for (std::size_t i = 0u; i < table.size(); ++i) {
+        Packed<ChunkEntry>::encode(table[i], std::span{bytes}.subspan(i * entry_size).first<entry_size>());
+    }
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+auto chunk_blocks(std::size_t block_length) noexcept -> std::size_t {
+    return std::clamp<std::size_t>(chunk_target_bytes / std::max<std::size_t>(block_length, 1u), 1u, 64u);
+}
+
+auto is_zero(std::span<const std::byte> block) noexcept -> bool {
+    return block.empty() || (block.front() == std::byte{0} && std::memcmp(block.data(), block.data() + 1, block.size() - 1) == 0);
+}
+
+/**
+ * @brief Reads compact image header, or leaves #file at its beginning if image is not compact
+ */
+auto read_compact_header(std::istream& file, std::string_view path) -> std::optional<CompactHeader> {
+    std::array<std::byte, header_size> bytes{};
+    const auto header = file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())
+                            ? Packed<CompactHeader>::decode(bytes)
+                            : CompactHeader{};
+    if (header.magic != compact_magic) {
+        file.clear();
+        file.seekg(0);
+        return std::nullopt;
+    }
+    if (header.version != compact_version || header.blocks_per_chunk == 0u || header.blocks_per_chunk > 64u) {
+        throw fs::Error{"disk image {} has unsupported format version {}", path, header.version};
+    }
+    return header;
+}
+
+/**
+ * @brief Reads stored chunk described by #entry and unpacks its stored blocks into #blocks
+ */
+void read_chunk(std::istream& file, const ChunkEntry& entry, std::size_t block_length, std::string_view path,
+                std::vector<std::byte>& stored, std::vector<std::byte>& blocks)
+{
+    blocks.resize(static_cast<std::size_t>(std::popcount(entry.stored_blocks)) * block_length);
+    stored.resize(entry.stored_size);
+    file.seekg(static_cast<std::streamoff>(entry.offset));
+    if (!file.read(reinterpret_cast<char*>(stored.data()), static_cast<std::streamsize>(stored.size()))
+        || stored.size() > blocks.size())
+    {
+        throw fs::Error{"disk image {} is corrupted", path};
+    }
+    if (stored.size() == blocks.size()) { // stored uncompressed
+        std::copy(stored.begin(), stored.end(), blocks.begin());
+    } else if (!fs::io::lz::decompress(stored, blocks)) {
+        throw fs::Error{"disk image {} is corrupted", path};
+    }
+}
+
+} // namespace
 
 fs::IO::IO(std::size_t ncyl, std::size_t ntracks, std::size_t nsectors, std::size_t block_length)
-    : _disk(ncyl * ntracks * nsectors, std::vector<std::byte>(block_length))
+    : IO(io::Geometry{.cylinders = ncyl, .tracks = ntracks, .sectors = nsectors}, block_length)
 {}
 
 fs::IO::IO(std::size_t nblocks, std::size_t block_length)
-    : _disk(nblocks, std::vector<std::byte>(block_length))
-{}
+    : IO(single_track(nblocks), block_length)
+{
+    _nblocks = nblocks;
+}
+
+fs::IO::IO(io::Geometry geometry, std::size_t block_length)
+    : _nblocks{geometry.blocks_number()}
+    , _block_length{block_length}
+    , _arena{static_cast<std::byte*>(::operator new[](_nblocks * block_length, std::align_val_t{kArenaAlignment})), ArenaDeleter{.mapped_length = 0u}}
+    , _dirty(_nblocks)
+    , _mutex{std::make_unique<std::mutex>()}
+    , _model{geometry}
+    , _scheduler{io::Scheduler::make(io::Scheduler::Policy::fifo)}
+{
+    std::fill_n(_arena.get(), _nblocks * _block_length, std::byte{0});
+}
+
+fs::IO::IO(std::string_view path, int fd, std::size_t nblocks, std::size_t block_length)
+    : _nblocks{nblocks}
+    , _block_length{block_length}
+    , _arena{static_cast<std::byte*>(nullptr), ArenaDeleter{.mapped_length = kHeaderSize + nblocks * block_length}}
+    , _image_path{path}
+    , _dirty(nblocks)
+    , _mutex{std::make_unique<std::mutex>()}
+    , _model{single_track(nblocks)}
+    , _scheduler{io::Scheduler::make(io::Scheduler::Policy::fifo)}
+{
+    void* mapping = ::mmap(nullptr, _arena.get_deleter().mapped_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        throw_system_error("cannot map disk image", path);
+    }
+    _arena.reset(static_cast<std::byte*>(mapping) + kHeaderSize); // blocks start right after the header
+}
+
+void fs::IO::ArenaDeleter::operator()(std::byte* arena) const noexcept {
+    if (mapped_length != 0) {
+        ::munmap(arena - kHeaderSize, mapped_length);
+    } else {
+        ::operator delete[](arena, std::align_val_t{kArenaAlignment});
+    }
+}
 
 auto fs::IO::read_block(std::size_t n, std::span<std::byte> to) const -> std::size_t {
-    const auto bytes_read = std::min(_disk[n].size(), to.size());
-    std::copy_n(_disk[n].begin(), bytes_read, to.begin());
-    return bytes_read;
+    return read_block(n, 0u, to);
+}
+
+auto fs::IO::read_block(std::size_t n, std::size_t offset, std::span<std::byte> to) const -> std::size_t {
+    const std::lock_guard lock{*_mutex};
+    return read_range(n, offset, to);
 }
 
 auto fs::IO::write_block(std::size_t n, std::span<const std::byte> bytes) -> std::size_t {
-    const auto bytes_written = std::min(_disk[n].size(), bytes.size());
-    std::copy_n(bytes.begin(), bytes_written, _disk[n].begin());
+    return write_block(n, 0u, bytes);
+}
+
+auto fs::IO::write_block(std::size_t n, std::size_t offset, std::span<const std::byte> bytes) -> std::size_t {
+    const std::lock_guard lock{*_mutex};
+    return write_range(n, offset, bytes);
+}
+
+auto fs::IO::read_blocks(std::span<const std::size_t> blocks, std::span<const std::span<std::byte>> to,
+                         std::size_t offset) const -> std::size_t
+{
+    const std::lock_guard lock{*_mutex}; // batch is served as a whole, requests of other threads wait for it
+    schedule(blocks, std::min(blocks.size(), to.size()));
+    std::size_t bytes_read = 0u;
+    for (const auto [block, slot] : _queue) {
+        bytes_read += read_range(block, slot == 0u ? offset : 0u, to[slot]);
+    }
+    return bytes_read;
+}
+
+auto fs::IO::write_blocks(std::span<const std::size_t> blocks, std::span<const std::span<const std::byte>> bytes,
+                          std::size_t offset) -> std::size_t
+{
+    const std::lock_guard lock{*_mutex};
+    schedule(blocks, std::min(blocks.size(), bytes.size()));
+    std::size_t bytes_written = 0u;
+    for (const auto [block, slot] : _queue) {
+        bytes_written += write_range(block, slot == 0u ? offset : 0u, bytes[slot]);
+    }
+    return bytes_written;
+}
+
+auto fs::IO::read_range(std::size_t n, std::size_t offset, std::span<std::byte> to) const -> std::size_t {
+    _model.access(n);
+    const auto skipped = std::min(offset, _block_length);
+    const auto bytes_read = std::min(_block_length - skipped, to.size());
+    std::copy_n(arena_block(n) + skipped, bytes_read, to.begin());
+    return bytes_read;
+}
+
+auto fs::IO::write_range(std::size_t n, std::size_t offset, std::span<const std::byte> bytes) -> std::size_t {
+    _model.access(n);
+    _dirty[n].store(true, std::memory_order_relaxed);
+    const auto skipped = std::min(offset, _block_length);
+    const auto bytes_written = std::min(_block_length - skipped, bytes.size());
+    std::copy_n(bytes.begin(), bytes_written, arena_block(n) + skipped);
     return bytes_written;
 }
 
+void fs::IO::schedule(std::span<const std::size_t> blocks, std::size_t n) const {
+    _queue.clear();
+    for (std::size_t slot = 0u; slot < n; ++slot) {
+        _queue.push_back({.block = blocks[slot], .slot = slot});
+    }
+    _scheduler->schedule(_queue, _model.geometry(), _model.head_cylinder());
+}
+
+auto fs::IO::block(std::size_t n) -> std::span<std::byte> {
+    {
+        const std::lock_guard lock{*_mutex};
+        _model.access(n); // metadata patched through views costs disk time like any transfer
+    }
+    _dirty[n].store(true, std::memory_order_relaxed);
+    return {arena_block(n), _block_length};
+}
+
+auto fs::IO::block(std::size_t n) const -> std::span<const std::byte> {
+    const std::lock_guard lock{*_mutex};
+    _model.access(n);
+    return {arena_block(n), _block_length};
+}
+
+auto fs::IO::arena_block(std::size_t n) const noexcept -> std::byte* {
+    return _arena.get() + n * _block_length;
+}
+
 auto fs::IO::blocks_number() const noexcept -> std::size_t {
-    return _disk.size();
+    return _nblocks;
 }
 
 auto fs::IO::block_length() const noexcept -> std::size_t {
-    return _disk.front().size();
+    return _block_length;
+}
+
+auto fs::IO::backend() const noexcept -> Backend {
+    return _arena.get_deleter().mapped_length != 0 ? Backend::mapped : Backend::memory;
+}
+
+auto fs::IO::geometry() const noexcept -> const io::Geometry& {
+    return _model.geometry();
+}
+
+void fs::IO::set_geometry(io::Geometry geometry) {
+    if (geometry.blocks_number() != _nblocks) {
+        throw Error{"geometry describes {} blocks, but disk has {}", geometry.blocks_number(), _nblocks};
+    }
+    const std::lock_guard lock{*_mutex};
+    _model = io::LatencyModel{geometry};
 }
 
-void fs::IO::save(std::string_view path) const
+void fs::IO::set_scheduler(io::Scheduler::Ptr scheduler) {
+    const std::lock_guard lock{*_mutex};
+    _scheduler = std::move(scheduler);
+}
+
+auto fs::IO::stats() const -> io::LatencyModel::Stats {
+    const std::lock_guard lock{*_mutex};
+    return _model.stats();
+}
+
+void fs::IO::reset_stats() {
+    const std::lock_guard lock{*_mutex};
+    _model.reset_stats();
+}
+
+void fs::IO::save(std::string_view path, Format format)
 {
+    std::error_code ec;
+    const bool same_image = !_image_path.empty() && std::filesystem::equivalent(path, _image_path, ec);
+    if (format == Format::compact) {
+        if (same_image && backend() == Backend::mapped) {
+            throw Error{"mapped disk cannot be saved over its own image {} in compact format", path};
+        }
+        save_compact(path);
+        if (backend() == Backend::memory) {
+            _image_path = path;
+            std::fill(_dirty.begin(), _dirty.end(), false);
+        }
+        return;
+    }
+
+    if (same_image) {
+        if (backend() == Backend::mapped) {
+            if (::msync(_arena.get() - kHeaderSize, _arena.get_deleter().mapped_length, MS_SYNC) != 0) { // kernel writes back only dirty pages
+                throw_system_error("cannot flush disk image", path);
+            }
+            std::fill(_dirty.begin(), _dirty.end(), false);
+            return;
+        }
+        if (save_dirty(path)) {
+            return;
+        }
+    }
+
     std::ofstream file{path.data(), std::ostream::binary | std::ostream::trunc};
     auto nblocks = static_cast<uint64_t>(blocks_number());
     auto block_len = static_cast<uint64_t>(block_length());
     file.write(reinterpret_cast<const char*>(&nblocks), sizeof(nblocks));
     file.write(reinterpret_cast<const char*>(&block_len), sizeof(block_len));
-    for (std::size_t i = 0; i < nblocks; ++i) {
-        file.write(reinterpret_cast<const char*>(_disk[i].data()), block_len);
+    file.write(reinterpret_cast<const char*>(_arena.get()), static_cast<std::streamsize>(nblocks * block_len));
+    if (!file) {
+        throw Error{"cannot write disk image {}", path};
+    }
+
+    if (backend() == Backend::memory) { // mapped disk keeps its own image
+        _image_path = path;
+        std::fill(_dirty.begin(), _dirty.end(), false);
+    }
+}
+
+void fs::IO::save_compact(std::string_view path) const
+{
+    const auto blocks_per_chunk = chunk_blocks(_block_length);
+    std::vector<ChunkEntry> table((_nblocks + blocks_per_chunk - 1) / blocks_per_chunk);
+    const CompactHeader header{
+        .magic = compact_magic,
+        .version = compact_version,
+        .blocks_per_chunk = static_cast<std::uint32_t>(blocks_per_chunk),
+        .nblocks = _nblocks,
+        .block_length = _block_length};
+
+    std::array<std::byte, header_size> header_bytes;
+    Packed<CompactHeader>::encode(header, header_bytes);
+
+    std::ofstream file{path.data(), std::ostream::binary | std::ostream::trunc};
+    file.write(reinterpret_cast<const char*>(header_bytes.data()), header_bytes.size());
+    write_chunk_table(file, table); // filled later
+
+    std::uint64_t offset = header_size + table.size() * entry_size;
+    std::vector<std::byte> blocks, compressed;
+    for (std::size_t chunk = 0u; chunk < table.size(); ++chunk) {
+        auto& entry = table[chunk];
+        blocks.clear();
+        for (std::size_t i = 0u; i < blocks_per_chunk && chunk * blocks_per_chunk + i < _nblocks; ++i) {
+            if (const auto data = std::span<const std::byte>{arena_block(chunk * blocks_per_chunk + i), _block_length}; !is_zero(data)) { // zero blocks are elided
+                entry.stored_blocks |= std::uint64_t{1} << i;
+                blocks.insert(blocks.end(), data.begin(), data.end());
+            }
+        }
+        if (blocks.empty()) {
+            continue;
+        }
+
+        compressed.clear();
+        io::lz::compress(blocks, compressed);
+        const auto& stored = compressed.size() < blocks.size() ? compressed : blocks;
+        entry.offset = offset;
+        entry.stored_size = static_cast<std::uint32_t>(stored.size());
+        file.write(reinterpret_cast<const char*>(stored.data()), static_cast<std::streamsize>(stored.size()));
+        offset += stored.size();
+    }
+
+    file.seekp(header_size);
+    write_chunk_table(file, table);
+    if (!file.flush()) {
+        throw Error{"cannot write disk image {}", path};
+    }
+}
+
+auto fs::IO::save_dirty(std::string_view path) -> bool
+{
+    std::fstream file{path.data(), std::fstream::binary | std::fstream::in | std::fstream::out};
+    std::uint64_t header[2] = {};
+    file.read(reinterpret_cast<char*>(header), kHeaderSize);
+    if (!file || header[0] != _nblocks || header[1] != _block_length
+        || std::filesystem::file_size(path) < kHeaderSize + _nblocks * _block_length)
+    {
+        return false;
+    }
+
+    for (std::size_t first = 0u; first < _nblocks; ++first) { // rewrite each run of consecutive dirty blocks at once
+        if (!_dirty[first]) {
+            continue;
+        }
+        auto last = first;
+        while (last < _nblocks && _dirty[last]) {
+            ++last;
+        }
+        file.seekp(static_cast<std::streamoff>(kHeaderSize + first * _block_length));
+        file.write(reinterpret_cast<const char*>(_arena.get() + first * _block_length),
+                   static_cast<std::streamsize>((last - first) * _block_length));
+        first = last;
+    }
+    if (!file.flush()) {
+        throw Error{"cannot write disk image {}", path};
     }
+
+    std::fill(_dirty.begin(), _dirty.end(), false);
+    return true;
 }
 
-auto fs::IO::load(std::string_view path) -> std::optional<fs::IO>
+auto fs::IO::load(std::string_view path, Backend backend) -> std::optional<fs::IO>
 {
+    if (backend == Backend::mapped) {
+        const FileDescriptor file{::open(std::string{path}.c_str(), O_RDWR)};
+        if (file.fd < 0) {
+            if (errno == ENOENT) {
+                return {};
+            }
+            throw_system_error("cannot open disk image", path);
+        }
+
+        std::uint64_t header[2];
+        struct stat status{};
+        if (::pread(file.fd, header, kHeaderSize, 0) != static_cast<ssize_t>(kHeaderSize) || ::fstat(file.fd, &status) != 0) {
+            throw Error{"{} is not a disk image", path};
+        }
+        if (std::memcmp(header, compact_magic.data(), compact_magic.size()) == 0) {
+            throw Error{"compact disk image {} cannot be memory-mapped", path};
+        }
+        const auto [nblocks, block_length] = header;
+        if (static_cast<std::uint64_t>(status.st_size) < kHeaderSize + nblocks * block_length) {
+            throw Error{"disk image {} is truncated", path};
+        }
+        return IO{path, file.fd, static_cast<std::size_t>(nblocks), static_cast<std::size_t>(block_length)};
+    }
+
     std::ifstream file{path.data(), std::ifstream::binary};
     if (!file.is_open()) {
         return {};
     }
+    if (read_compact_header(file, path)) {
+        file.seekg(0);
+        return load_compact(file, path);
+    }
     auto nblocks = [&] {
         uint64_t n;
         file.read(reinterpret_cast<char*>(&n), sizeof(n));
@@ -60,11 +552,98 @@ auto fs::IO::load(std::string_view path) -> std::optional<fs::IO>
         return static_cast<std::size_t>(n);
     }();
     fs::IO io(nblocks, block_length);
-    for (std::size_t i = 0; i < nblocks; ++i) {
-        std::vector<std::byte> bytes(block_length);
-        file.read(reinterpret_cast<char*>(bytes.data()), block_length);
-        io.write_block(i, bytes);
+    file.read(reinterpret_cast<char*>(io._arena.get()), static_cast<std::streamsize>(nblocks * block_length)); // read whole disk at once
+    io._image_path = path;
+    return io;
+}
+
+auto fs::IO::load_compact(std::istream& file, std::string_view path) -> IO
+{
+    const auto header = read_compact_header(file, path).value();
+    const auto table = read_chunk_table(file, (header.nblocks + header.blocks_per_chunk - 1) / header.blocks_per_chunk);
+    if (!table) {
+        throw Error{"disk image {} is truncated", path};
+    }
+
+    fs::IO io(header.nblocks, header.block_length);
+    std::vector<std::byte> stored, blocks;
+    for (std::size_t chunk = 0u; chunk < table->size(); ++chunk) {
+        const auto& entry = (*table)[chunk];
+        if (entry.stored_blocks == 0u) { // all blocks of chunk are zero
+            continue;
+        }
+        read_chunk(file, entry, io._block_length, path, stored, blocks);
+        auto next = blocks.begin();
+        for (auto mask = entry.stored_blocks; mask != 0u; mask &= mask - 1) {
+            const auto n = chunk * header.blocks_per_chunk + static_cast<std::size_t>(std::countr_zero(mask));
+            if (n >= io._nblocks) {
+                throw Error{"disk image {} is corrupted", path};
+            }
+            std::copy_n(next, io._block_length, io._arena.get() + n * io._block_length);
+            next += static_cast<std::ptrdiff_t>(io._block_length);
+        }
     }
+    io._image_path = path;
     return io;
 }
 
+auto fs::IO::read_image_block(std::string_view path, std::size_t n, std::span<std::byte> to) -> std::size_t
+{
+    std::ifstream file{path.data(), std::ifstream::binary};
+    if (!file.is_open()) {
+        throw Error{"cannot open disk image {}", path};
+    }
+
+    const auto header = read_compact_header(file, path);
+    if (!header) { // raw image: block is right where it is on disk
+        std::uint64_t raw_header[2] = {};
+        file.read(reinterpret_cast<char*>(raw_header), kHeaderSize);
+        if (n >= raw_header[0]) {
+            throw Error{"block {} is out of bounds of disk image {}", n, path};
+        }
+        const auto bytes_read = std::min<std::size_t>(to.size(), raw_header[1]);
+        file.seekg(static_cast<std::streamoff>(kHeaderSize + n * raw_header[1]));
+        if (!file.read(reinterpret_cast<char*>(to.data()), static_cast<std::streamsize>(bytes_read))) {
+            throw Error{"disk image {} is truncated", path};
+        }
+        return bytes_read;
+    }
+
+    if (n >= header->nblocks) {
+        throw Error{"block {} is out of bounds of disk image {}", n, path};
+    }
+    const auto bytes_read = std::min<std::size_t>(to.size(), header->block_length);
+    file.seekg(static_cast<std::streamoff>(header_size + n / header->blocks_per_chunk * entry_size));
+    const auto table = read_chunk_table(file, 1u);
+    if (!table) {
+        throw Error{"disk image {} is truncated", path};
+    }
+    const auto& entry = table->front();
+
+    const auto bit = std::uint64_t{1} << (n % header->blocks_per_chunk);
+    if ((entry.stored_blocks & bit) == 0u) { // zero block is not stored
+        std::fill_n(to.begin(), bytes_read, std::byte{0});
+        return bytes_read;
+    }
+    std::vector<std::byte> stored, blocks;
+    read_chunk(file, entry, header->block_length, path, stored, blocks);
+    const auto rank = static_cast<std::size_t>(std::popcount(entry.stored_blocks & (bit - 1))); // stored blocks before ours
+    std::copy_n(blocks.begin() + static_cast<std::ptrdiff_t>(rank * header->block_length), bytes_read, to.begin());
+    return bytes_read;
+}
+
+auto fs::IO::map(std::string_view path, std::size_t nblocks, std::size_t block_length) -> IO
+{
+    const FileDescriptor file{::open(std::string{path}.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)};
+    if (file.fd < 0) {
+        throw_system_error("cannot create disk image", path);
+    }
+
+    const std::uint64_t header[2] = {nblocks, block_length};
+    if (::ftruncate(file.fd, static_cast<off_t>(kHeaderSize + nblocks * block_length)) != 0 // zero-filled and sparse
+        || ::pwrite(file.fd, header, kHeaderSize, 0) != static_cast<ssize_t>(kHeaderSize))
+    {
+        throw_system_error("cannot create disk image", path);
+    }
+    return IO{path, file.fd, nblocks, block_length};
+}
@@ -0,0 +1,134 @@
+#include <IO/Compression.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+namespace fs::io::lz {
+namespace {
+
+constexpr std::size_t min_match = 4u;
+constexpr std::size_t max_offset = 0xFFFFu;
+constexpr std::size_t hash_bits = 12u;
+constexpr std::size_t length_mask = 0xFu;  // lengths that do not fit token nibble continue in extra bytes
+
+auto read32(const std::byte* p) noexcept -> std::uint32_t {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+auto hash(std::uint32_t sequence) noexcept -> std::size_t {
+    return (sequence * 2654435761u) >> (32u - hash_bits);
+}
+
+void put_length(std::vector<std::byte>& dst, std::size_t length) {
+    for (; length >= 0xFFu; length -= 0xFFu) {
+        dst.push_back(std::byte{0xFF});
+    }
+    dst.push_back(static_cast<std::byte>(length));
+}
+
+void put_sequence(std::vector<std::byte>& dst, std::span<const std::byte> literals, std::size_t offset, std::size_t match) {
+    const auto extra_match = match != 0u ? match - min_match : 0u;
+    dst.push_back(static_cast<std::byte>((std::min(literals.size(), length_mask) << 4u) | std::min(extra_match, length_mask)));
+    if (literals.size() >= length_mask) {
+        put_length(dst, literals.size() - length_mask);
+    }
+    dst.insert(dst.end(), literals.begin(), literals.end());
+    if (match == 0u) { // last sequence holds only literals
+        return;
+    }
+    dst.push_back(static_cast<std::byte>(offset & 0xFFu));
+    dst.push_back(static_cast<std::byte>(offset >> 8u));
+    if (extra_match >= length_mask) {
+        put_length(dst, extra_match - length_mask);
+    }
+}
+
+} // namespace
+
+void compress(std::span<const std::byte> src, std::vector<std::byte>& dst)
+{
+    std::array<std::size_t, 1u << hash_bits> table; // position + 1 of last sequence with the hash, 0 if none
+    table.fill(0u);
+
+    const auto data = src.data();
+    std::size_t anchor = 0u;
+    std::size_t i = 0u;
+    while (i + min_match <= src.size()) {
+        const auto sequence = read32(data + i);
+        auto& slot = table[hash(sequence)];
+        const auto candidate = slot;
+        slot = i + 1u;
+        if (candidate == 0u || i + 1u - candidate > max_offset || read32(data + candidate - 1u) != sequence) {
+            ++i;
+            continue;
+        }
+
+        const auto match_start = candidate - 1u;
+        auto match = min_match;
+        while (i + match < src.size() && data[match_start + match] == data[i + match]) {
+            ++match;
+        }
+        put_sequence(dst, src.subspan(anchor, i - anchor), i - match_start, match);
+        i += match;
+        anchor = i;
+    }
+    put_sequence(dst, src.subspan(anchor), 0u, 0u);
+}
+
+auto decompress(std::span<const std::byte> src, std::span<std::byte> dst) -> bool
+{
+    const auto read_length = [&src] (std::size_t length) -> std::optional<std::size_t> {
+        if (length != length_mask) {
+            return length;
+        }
+        for (;;) {
+            if (src.empty()) {
+                return std::nullopt;
+            }
+            const auto extra = static_cast<std::size_t>(src.front());
+            src = src.subspan(1u);
+            length += extra;
+            if (extra != 0xFFu) {
+                return length;
+            }
+        }
+    };
+
+    std::size_t out = 0u;
+    while (!src.empty()) {
+        const auto token = static_cast<std::size_t>(src.front());
+        src = src.subspan(1u);
+
+        const auto literals = read_length(token >> 4u);
+        if (!literals || *literals > src.size() || *literals > dst.size() - out) {
+            return false;
+        }
+        std::copy_n(src.begin(), *literals, dst.begin() + out);
+        src = src.subspan(*literals);
+        out += *literals;
+        if (src.empty()) { // last sequence
+            break;
+        }
+
+        if (src.size() < 2u) {
+            return false;
+        }
+        const auto offset = static_cast<std::size_t>(src[0]) | (static_cast<std::size_t>(src[1]) << 8u);
+        src = src.subspan(2u);
+        const auto extra_match = read_length(token & length_mask);
+        if (!extra_match || offset == 0u || offset > out || *extra_match + min_match > dst.size() - out) {
+            return false;
+        }
+        for (std::size_t k = 0u; k < *extra_match + min_match; ++k, ++out) { // source may overlap output
+            dst[out] = dst[out - offset];
+        }
+    }
+    return out == dst.size();
+}
+
+} // namespace fs::io::lz
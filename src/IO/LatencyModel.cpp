@@ -0,0 +1,56 @@
+#include <IO/LatencyModel.hpp>
+
+#include <cmath>
+
+namespace fs::io {
+
+LatencyModel::LatencyModel(Geometry geometry) noexcept
+    : LatencyModel(geometry, Timing{})
+{}
+
+LatencyModel::LatencyModel(Geometry geometry, Timing timing) noexcept
+    : _geometry{geometry}
+    , _timing{timing}
+{}
+
+auto LatencyModel::access(std::size_t block) noexcept -> double {
+    const auto [cylinder, track, sector] = _geometry.address(block);
+    const auto started_ms = _clock_ms;
+
+    if (const auto distance = cylinder > _head_cylinder ? cylinder - _head_cylinder : _head_cylinder - cylinder;
+        distance != 0u)
+    {
+        _clock_ms += _timing.seek_settle_ms + _timing.seek_per_cylinder_ms * static_cast<double>(distance);
+        _head_cylinder = cylinder;
+        ++_stats.seeks;
+        _stats.cylinders_travelled += distance;
+    }
+
+    const auto sectors = static_cast<double>(_geometry.sectors);
+    const auto sector_ms = _timing.rotation_ms / sectors;
+    const auto under_head = std::fmod(_clock_ms / sector_ms, sectors); // platter keeps spinning during seeks
+    const auto sectors_to_wait = std::fmod(static_cast<double>(sector) - under_head + sectors, sectors);
+    _clock_ms += (sectors_to_wait + 1.) * sector_ms; // rotational delay and transfer of the sector
+
+    ++_stats.accesses;
+    _stats.elapsed_ms += _clock_ms - started_ms;
+    return _clock_ms - started_ms;
+}
+
+auto LatencyModel::geometry() const noexcept -> const Geometry& {
+    return _geometry;
+}
+
+auto LatencyModel::head_cylinder() const noexcept -> std::size_t {
+    return _head_cylinder;
+}
+
+auto LatencyModel::stats() const noexcept -> const Stats& {
+    return _stats;
+}
+
+void LatencyModel::reset_stats() noexcept {
+    _stats = {};
+}
+
+} // namespace fs::io
@@ -0,0 +1,100 @@
+#include <IO/Scheduler.hpp>
+
+#include <algorithm>
+
+namespace fs::io {
+namespace {
+
+/**
+ * @brief Orders requests by cylinder, then by rotational position within it.
+ */
+auto ascending(const Geometry& geometry) {
+    return [&geometry] (const Request& lhs, const Request& rhs) {
+        const auto l = geometry.address(lhs.block), r = geometry.address(rhs.block);
+        return l.cylinder != r.cylinder ? l.cylinder < r.cylinder : l.sector < r.sector;
+    };
+}
+
+/**
+ * @brief Orders requests for a downward sweep, opposite to ascending. Requests to the same block stay equal.
+ */
+auto descending(const Geometry& geometry) {
+    return [&geometry] (const Request& lhs, const Request& rhs) {
+        const auto l = geometry.address(lhs.block), r = geometry.address(rhs.block);
+        return l.cylinder != r.cylinder ? l.cylinder > r.cylinder : l.sector > r.sector;
+    };
+}
+
+struct Fifo final : Scheduler
+{
+    void schedule(std::span<Request>, const Geometry&, std::size_t) override
+    {}
+
+    auto policy() const noexcept -> Policy override {
+        return Policy::fifo;
+    }
+};
+
+struct Scan final : Scheduler
+{
+    bool upwards = true;  // current sweep direction, kept between batches
+
+    void schedule(std::span<Request> queue, const Geometry& geometry, std::size_t head_cylinder) override
+    {
+        std::stable_sort(queue.begin(), queue.end(), ascending(geometry));
+        const auto split = std::partition_point(queue.begin(), queue.end(), [&] (const Request& request) {
+            return geometry.address(request.block).cylinder < head_cylinder;
+        });
+
+        const auto below = split - queue.begin();
+        const auto above = queue.end() - split;
+        if ((upwards && above == 0) || (!upwards && below == 0)) {
+            upwards = !upwards; // nothing left in the current direction
+        }
+        if (upwards) { // [head, max] upwards, then (head, min] downwards
+            std::rotate(queue.begin(), split, queue.end());
+            std::stable_sort(queue.end() - below, queue.end(), descending(geometry));
+            upwards = below == 0;
+        } else {       // (head, min] downwards, then [head, max] upwards
+            std::stable_sort(queue.begin(), split, descending(geometry)); // not reversed, which would swap requests to one block
+            upwards = above != 0;
+        }
+    }
+
+    auto policy() const noexcept -> Policy override {
+        return Policy::scan;
+    }
+};
+
+struct CLook final : Scheduler
+{
+    void schedule(std::span<Request> queue, const Geometry& geometry, std::size_t head_cylinder) override
+    {
+        std::stable_sort(queue.begin(), queue.end(), ascending(geometry));
+        const auto split = std::partition_point(queue.begin(), queue.end(), [&] (const Request& request) {
+            return geometry.address(request.block).cylinder < head_cylinder;
+        });
+        std::rotate(queue.begin(), split, queue.end()); // [head, max], then [min, head)
+    }
+
+    auto policy() const noexcept -> Policy override {
+        return Policy::clook;
+    }
+};
+
+} // namespace
+
+auto Scheduler::make(const Policy policy) -> Ptr
+{
+    switch (policy) {
+        case Policy::scan:
+            return std::make_unique<Scan>();
+        case Policy::clook:
+            return std::make_unique<CLook>();
+        case Policy::fifo:
+            break;
+    }
+    return std::make_unique<Fifo>();
+}
+
+} // namespace fs::io